@@ -4,29 +4,25 @@ layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 layout (location = 3) in vec3 instancePos;
 layout (location = 4) in vec3 instanceScale;
+layout (location = 5) in vec4 instanceRotation; // unit quaternion (x, y, z, w), the orientation the container collides with
 
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+layout (std140) uniform CameraMatrices { // shared by all the programs, updated once per frame
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+};
 
 out vec3 fragmentPos;
 out vec3 fragNormal;
 
-// TODO compute the scale later
-mat4 translationMatrix(vec3 translation, vec3 scale)
+vec3 rotate(vec4 q, vec3 v)
 {
-    return mat4
-    (
-        vec4(scale.x, 0.0, 0.0, 0.0),
-        vec4(0.0, scale.y, 0.0, 0.0),
-        vec4(0.0, 0.0, scale.z, 0.0),
-        vec4(translation, 1.0)
-    );
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
 }
 
 void main()
 {
-    mat4 model = translationMatrix(instancePos, instanceScale);
-    fragmentPos = vec3(model * vec4(aPos, 1.0));
-    fragNormal = aNormal;
-    gl_Position = projectionMatrix * viewMatrix * model * vec4(aPos, 1.0);
+    // scaled in the space of the container, then rotated around its position
+    fragmentPos = instancePos + rotate(instanceRotation, aPos * instanceScale);
+    fragNormal = rotate(instanceRotation, aNormal);
+    gl_Position = projectionMatrix * viewMatrix * vec4(fragmentPos, 1.0);
 }
\ No newline at end of file
@@ -3,8 +3,10 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoords;
 
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+layout (std140) uniform CameraMatrices { // shared by all the programs, updated once per frame
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+};
 
 out vec2 TexCoords;
 
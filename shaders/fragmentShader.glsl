@@ -1,14 +1,41 @@
 #version 330 core
 
-in vec2 TexCoords;
+layout (std140) uniform CameraMatrices { // shared by all the programs, updated once per frame
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+};
+
+in vec3 worldPos;
+flat in vec3 sphereCenter;
+flat in float sphereRadius;
+flat in vec3 eyePos;
 
 out vec4 FragColor;
 
 void main()
 {
-    float r = length(TexCoords * 2.0 - 1.0);
-    if (r > 1.0)
+    // ray cast the sphere from the camera through the quad
+    vec3 rayDir = normalize(worldPos - eyePos);
+    vec3 oc = eyePos - sphereCenter;
+    float b = dot(oc, rayDir);
+    float disc = b * b - (dot(oc, oc) - sphereRadius * sphereRadius);
+    if (disc < 0.0)
         discard;
+    vec3 hit = eyePos + rayDir * (-b - sqrt(disc));
+    vec3 normal = (hit - sphereCenter) / sphereRadius;
+
+    // depth of the sphere surface (instead of the quad) so that the impostors intersect like the meshes
+    vec4 clip = projectionMatrix * viewMatrix * vec4(hit, 1.0);
+    gl_FragDepth = (clip.z / clip.w) * 0.5 + 0.5;
+
+    // same lighting as the model shader
+    float ambientStrength = 0.5f;
+    vec3 lightColor = vec3(1.0f, 0.5f, 1.0f);
+    vec3 lightPos = vec3(30.0f, 55.0f, 105.0f);
+    vec3 lightDir = normalize(lightPos - hit);
+    vec3 diffuse = max(dot(normal, lightDir), 0.0) * lightColor;
+
+    vec3 color = vec3(1.0f, 1.0f, 0.5f);
 
-    FragColor = vec4(vec3(1.0 - r), 1.0);
-}
\ No newline at end of file
+    FragColor = vec4(color * (ambientStrength + diffuse), 1.0f);
+}
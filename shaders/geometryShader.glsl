@@ -3,31 +3,49 @@
 layout (points) in;
 layout (triangle_strip, max_vertices = 4) out;
 
+layout (std140) uniform CameraMatrices { // shared by all the programs, updated once per frame
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+};
+
+in vec3 center[];
 in float radius[];
 
-out vec2 TexCoords;
+out vec3 worldPos;
+flat out vec3 sphereCenter;
+flat out float sphereRadius;
+flat out vec3 eyePos;
 
 void main() {
-    vec4 pos = gl_in[0].gl_Position;
+    vec3 c = center[0];
     float r = radius[0];
 
-    r = 2.421 * r;
-
-    gl_Position = pos + vec4(-r, -r, 0.0, 0.0);
-    TexCoords = vec2(0.0, 0.0);
-    EmitVertex();
-
-    gl_Position = pos + vec4(r, -r, 0.0, 0.0);
-    TexCoords = vec2(1.0, 0.0);
-    EmitVertex();
-
-    gl_Position = pos + vec4(-r, r, 0.0, 0.0);
-    TexCoords = vec2(0.0, 1.0);
-    EmitVertex();
-
-    gl_Position = pos + vec4(r, r, 0.0, 0.0);
-    TexCoords = vec2(1.0, 1.0);
-    EmitVertex();
+    // camera position and up vector in world space
+    vec3 eye = -transpose(mat3(viewMatrix)) * viewMatrix[3].xyz;
+    vec3 cameraUp = vec3(viewMatrix[0][1], viewMatrix[1][1], viewMatrix[2][1]);
+
+    vec3 toCenter = c - eye;
+    float d = length(toCenter);
+    if (d <= r) {
+        return; // camera inside the sphere
+    }
+    vec3 forward = toCenter / d;
+
+    // the quad faces the camera and covers the silhouette of the sphere (the cone tangent to the sphere cut at its center)
+    vec3 right = normalize(cross(forward, cameraUp));
+    vec3 up = cross(right, forward);
+    float s = r * d / sqrt(d * d - r * r);
+
+    mat4 viewProjection = projectionMatrix * viewMatrix;
+    vec2 corners[4] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(-1.0, 1.0), vec2(1.0, 1.0));
+    for (int i = 0; i < 4; i++) {
+        worldPos = c + (corners[i].x * right + corners[i].y * up) * s;
+        sphereCenter = c;
+        sphereRadius = r;
+        eyePos = eye;
+        gl_Position = viewProjection * vec4(worldPos, 1.0);
+        EmitVertex();
+    }
 
     EndPrimitive();
-}
\ No newline at end of file
+}
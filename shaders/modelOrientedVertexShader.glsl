@@ -2,80 +2,41 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in vec3 instancePos;
-layout (location = 4) in vec3 instanceScale;
-layout (location = 5) in vec3 instanceRotation; // New input for the rotation matrix
+layout (location = 3) in vec4 instanceStart; // first end of the link and radius of the cylinder
+layout (location = 4) in vec4 instanceEnd; // second end of the link
 
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+layout (std140) uniform CameraMatrices { // shared by all the programs, updated once per frame
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+};
 
 out vec3 fragmentPos;
 out vec3 fragNormal;
 
-mat4 rotationMatrix(vec3 rotation)
+// rotation taking the y axis of the model to the unit vector n, built without trigonometry
+// (orthonormal basis of Duff et al., "Building an Orthonormal Basis, Revisited")
+mat3 alignY(vec3 n)
 {
-    float rotX = radians(rotation.x);
-    float rotY = radians(rotation.y);
-    float rotZ = radians(rotation.z);
-
-    mat4 rotationX = mat4
-    (
-        vec4(1.0, 0.0, 0.0, 0.0),
-        vec4(0.0, cos(rotX), -sin(rotX), 0.0),
-        vec4(0.0, sin(rotX), cos(rotX), 0.0),
-        vec4(0.0, 0.0, 0.0, 1.0)
-    );
-
-    mat4 rotationY = mat4
-    (
-        vec4(cos(rotY), 0.0, sin(rotY), 0.0),
-        vec4(0.0, 1.0, 0.0, 0.0),
-        vec4(-sin(rotY), 0.0, cos(rotY), 0.0),
-        vec4(0.0, 0.0, 0.0, 1.0)
-    );
-
-    mat4 rotationZ = mat4
-    (
-        vec4(cos(rotZ), -sin(rotZ), 0.0, 0.0),
-        vec4(sin(rotZ), cos(rotZ), 0.0, 0.0),
-        vec4(0.0, 0.0, 1.0, 0.0),
-        vec4(0.0, 0.0, 0.0, 1.0)
-    );
-
-    return rotationZ * rotationY * rotationX;
-}
-
-mat4 translationMatrix(vec3 translation)
-{
-    return mat4
-    (
-        vec4(1.0, 0.0, 0.0, 0.0),
-        vec4(0.0, 1.0, 0.0, 0.0),
-        vec4(0.0, 0.0, 1.0, 0.0),
-        vec4(translation, 1.0)
-    );
-}
-
-mat4 scaleMatrix(vec3 scale) {
-    return mat4(
-        vec4(scale.x, 0.0, 0.0, 0.0),
-        vec4(0.0, scale.y, 0.0, 0.0),
-        vec4(0.0, 0.0, scale.z, 0.0),
-        vec4(0.0, 0.0, 0.0, 1.0)
-    );
-
-}
-
-mat4 modelMatrix(vec3 translation, vec3 scale, vec3 rotation)
-{
-    return translationMatrix(translation) * rotationMatrix(rotation) * scaleMatrix(scale);
+    float s = n.z >= 0.0 ? 1.0 : -1.0;
+    float a = -1.0 / (s + n.z);
+    float b = n.x * n.y * a;
+    vec3 t1 = vec3(1.0 + s * n.x * n.x * a, s * b, -s * n.x);
+    vec3 t2 = vec3(b, s + n.y * n.y * a, -n.y);
+    return mat3(t2, n, t1);
 }
 
 void main()
 {
-    mat4 model = modelMatrix(instancePos, instanceScale, instanceRotation);
-    fragmentPos = vec3(model * vec4(aPos, 1.0));
-    mat3 normalMatrix = mat3(rotationMatrix(instanceRotation));
-    fragNormal = normalize(normalMatrix * aNormal);
-    gl_Position = projectionMatrix * viewMatrix * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    vec3 axis = instanceEnd.xyz - instanceStart.xyz;
+    float len = length(axis);
+    vec3 direction = len > 0.0 ? axis / len : vec3(0.0, 1.0, 0.0);
+    mat3 rotation = alignY(direction);
+
+    // the cylinder of the model spans [-1, 1] along y
+    vec3 scale = vec3(instanceStart.w, len * 0.5, instanceStart.w);
+    vec3 center = (instanceStart.xyz + instanceEnd.xyz) * 0.5;
+
+    fragmentPos = center + rotation * (aPos * scale);
+    fragNormal = normalize(rotation * aNormal);
+    gl_Position = projectionMatrix * viewMatrix * vec4(fragmentPos, 1.0);
+}
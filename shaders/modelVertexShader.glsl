@@ -5,8 +5,10 @@ layout (location = 2) in vec2 aTexCoords;
 layout (location = 3) in vec3 instancePos;
 layout (location = 4) in vec3 instanceScale;
 
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+layout (std140) uniform CameraMatrices { // shared by all the programs, updated once per frame
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+};
 
 out vec3 fragmentPos;
 out vec3 fragNormal;
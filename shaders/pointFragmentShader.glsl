@@ -0,0 +1,10 @@
+#version 330 core
+
+out vec4 FragColor;
+
+void main()
+{
+    // average shade of a lit sphere of the model shader
+    vec3 color = vec3(1.0f, 1.0f, 0.5f);
+    FragColor = vec4(color * 0.8f, 1.0f);
+}
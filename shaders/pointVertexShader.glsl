@@ -0,0 +1,13 @@
+#version 330 core
+
+layout (location = 0) in vec4 aSphere; // position and radius of the sphere
+
+layout (std140) uniform CameraMatrices { // shared by all the programs, updated once per frame
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+};
+
+void main()
+{
+    gl_Position = projectionMatrix * viewMatrix * vec4(aSphere.xyz, 1.0);
+}
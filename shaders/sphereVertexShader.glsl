@@ -0,0 +1,20 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec4 instanceData; // position and radius of the sphere
+
+layout (std140) uniform CameraMatrices { // shared by all the programs, updated once per frame
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+};
+
+out vec3 fragmentPos;
+out vec3 fragNormal;
+
+void main()
+{
+    fragmentPos = instanceData.xyz + aPos * instanceData.w;
+    fragNormal = aNormal;
+    gl_Position = projectionMatrix * viewMatrix * vec4(fragmentPos, 1.0);
+}
@@ -1,15 +1,13 @@
 #version 330 core
 
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in float aRadius;
-
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+layout (location = 0) in vec4 aSphere; // position and radius of the sphere
 
+out vec3 center;
 out float radius;
 
 void main()
 {
-    gl_Position = projectionMatrix * viewMatrix * vec4(aPos, 1.0);
-    radius = aRadius;
-}
\ No newline at end of file
+    // the quad is built around the sphere in the geometry shader
+    center = aSphere.xyz;
+    radius = aSphere.w;
+}
@@ -0,0 +1,276 @@
+#include "bvh.hpp"
+#include "../utils/geometry.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#define BVH_BINS 12
+#define BVH_LEAF_SIZE 4
+#define BVH_MAX_DEPTH 48 // keeps the traversal stacks bounded
+
+static float surfaceArea(glm::vec3 min, glm::vec3 max) {
+    glm::vec3 e = glm::max(max - min, glm::vec3(0.0f));
+    return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+}
+
+void BVH::build(const std::vector<glm::vec3>& vertices) {
+    const int num_triangles = static_cast<int>(vertices.size() / 3);
+    nodes.clear();
+    triangleIndices.resize(num_triangles);
+    triangleMin.resize(num_triangles);
+    triangleMax.resize(num_triangles);
+    centroids.resize(num_triangles);
+    for (int i = 0; i < num_triangles; ++i) {
+        glm::vec3 a = vertices[3 * i], b = vertices[3 * i + 1], c = vertices[3 * i + 2];
+        triangleIndices[i] = i;
+        triangleMin[i] = glm::min(a, glm::min(b, c));
+        triangleMax[i] = glm::max(a, glm::max(b, c));
+        centroids[i] = (a + b + c) / 3.0f;
+    }
+    if (num_triangles == 0) {
+        return;
+    }
+
+    nodes.reserve(2 * num_triangles);
+    nodes.push_back({glm::vec3(0.0f), glm::vec3(0.0f), 0, num_triangles});
+    updateBounds(nodes[0]);
+    subdivide(0, 0);
+
+    // the build data is not needed anymore
+    triangleMin.clear();
+    triangleMax.clear();
+    centroids.clear();
+}
+
+void BVH::updateBounds(Node& node) {
+    node.min = glm::vec3(std::numeric_limits<float>::max());
+    node.max = glm::vec3(-std::numeric_limits<float>::max());
+    for (int i = node.first; i < node.first + node.count; ++i) {
+        node.min = glm::min(node.min, triangleMin[triangleIndices[i]]);
+        node.max = glm::max(node.max, triangleMax[triangleIndices[i]]);
+    }
+}
+
+void BVH::subdivide(int nodeIndex, int depth) {
+    Node node = nodes[nodeIndex];
+    if (node.count <= BVH_LEAF_SIZE || depth >= BVH_MAX_DEPTH) {
+        return;
+    }
+
+    // bounds of the centroids, the bins are spread over them
+    glm::vec3 centroidMin = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 centroidMax = glm::vec3(-std::numeric_limits<float>::max());
+    for (int i = node.first; i < node.first + node.count; ++i) {
+        centroidMin = glm::min(centroidMin, centroids[triangleIndices[i]]);
+        centroidMax = glm::max(centroidMax, centroids[triangleIndices[i]]);
+    }
+
+    // binned surface area heuristic, looking for the cheapest split plane over the 3 axes
+    int bestAxis = -1;
+    int bestSplit = 0;
+    float bestCost = surfaceArea(node.min, node.max) * node.count; // cost of keeping a leaf
+    for (int axis = 0; axis < 3; ++axis) {
+        float extent = centroidMax[axis] - centroidMin[axis];
+        if (extent <= 0.0f) {
+            continue;
+        }
+        glm::vec3 binMin[BVH_BINS], binMax[BVH_BINS];
+        int binCount[BVH_BINS] = {0};
+        for (int b = 0; b < BVH_BINS; ++b) {
+            binMin[b] = glm::vec3(std::numeric_limits<float>::max());
+            binMax[b] = glm::vec3(-std::numeric_limits<float>::max());
+        }
+        float scale = BVH_BINS / extent;
+        for (int i = node.first; i < node.first + node.count; ++i) {
+            int t = triangleIndices[i];
+            int b = std::min(BVH_BINS - 1, static_cast<int>((centroids[t][axis] - centroidMin[axis]) * scale));
+            binCount[b]++;
+            binMin[b] = glm::min(binMin[b], triangleMin[t]);
+            binMax[b] = glm::max(binMax[b], triangleMax[t]);
+        }
+
+        // sweep from both sides to get the area and count on each side of every split
+        float leftArea[BVH_BINS - 1], rightArea[BVH_BINS - 1];
+        int leftCount[BVH_BINS - 1], rightCount[BVH_BINS - 1];
+        glm::vec3 lMin = glm::vec3(std::numeric_limits<float>::max()), lMax = -lMin;
+        glm::vec3 rMin = lMin, rMax = lMax;
+        int lSum = 0, rSum = 0;
+        for (int b = 0; b < BVH_BINS - 1; ++b) {
+            lSum += binCount[b];
+            lMin = glm::min(lMin, binMin[b]);
+            lMax = glm::max(lMax, binMax[b]);
+            leftCount[b] = lSum;
+            leftArea[b] = lSum > 0 ? surfaceArea(lMin, lMax) : 0.0f;
+            int rb = BVH_BINS - 1 - b;
+            rSum += binCount[rb];
+            rMin = glm::min(rMin, binMin[rb]);
+            rMax = glm::max(rMax, binMax[rb]);
+            rightCount[rb - 1] = rSum;
+            rightArea[rb - 1] = rSum > 0 ? surfaceArea(rMin, rMax) : 0.0f;
+        }
+        for (int b = 0; b < BVH_BINS - 1; ++b) {
+            float cost = leftArea[b] * leftCount[b] + rightArea[b] * rightCount[b];
+            if (leftCount[b] > 0 && rightCount[b] > 0 && cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    if (bestAxis < 0) { // splitting is not worth it
+        return;
+    }
+
+    // partition the triangles around the chosen plane
+    float extent = centroidMax[bestAxis] - centroidMin[bestAxis];
+    float scale = BVH_BINS / extent;
+    auto middle = std::partition(triangleIndices.begin() + node.first, triangleIndices.begin() + node.first + node.count, [&](int t) {
+        int b = std::min(BVH_BINS - 1, static_cast<int>((centroids[t][bestAxis] - centroidMin[bestAxis]) * scale));
+        return b <= bestSplit;
+    });
+    int leftCount = static_cast<int>(middle - triangleIndices.begin()) - node.first;
+
+    int left = static_cast<int>(nodes.size());
+    nodes.push_back({glm::vec3(0.0f), glm::vec3(0.0f), node.first, leftCount});
+    nodes.push_back({glm::vec3(0.0f), glm::vec3(0.0f), node.first + leftCount, node.count - leftCount});
+    updateBounds(nodes[left]);
+    updateBounds(nodes[left + 1]);
+    nodes[nodeIndex].first = left;
+    nodes[nodeIndex].count = 0;
+
+    subdivide(left, depth + 1);
+    subdivide(left + 1, depth + 1);
+}
+
+void BVH::query(glm::vec3 min, glm::vec3 max, std::vector<int>& triangles) const {
+    triangles.clear();
+    if (nodes.empty()) {
+        return;
+    }
+    int stack[BVH_MAX_DEPTH + 2];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node& node = nodes[stack[--stackSize]];
+        if (glm::any(glm::lessThan(node.max, min)) || glm::any(glm::greaterThan(node.min, max))) {
+            continue;
+        }
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; ++i) {
+                triangles.push_back(triangleIndices[i]);
+            }
+        } else {
+            stack[stackSize++] = node.first;
+            stack[stackSize++] = node.first + 1;
+        }
+    }
+}
+
+float BVH::raycast(glm::vec3 origin, glm::vec3 direction, const std::vector<glm::vec3>& vertices, int& triangle) const {
+    triangle = -1;
+    float best = std::numeric_limits<float>::max();
+    if (nodes.empty()) {
+        return -1.0f;
+    }
+    glm::vec3 invDirection = 1.0f / direction;
+    int stack[BVH_MAX_DEPTH + 2];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node& node = nodes[stack[--stackSize]];
+        // slab test against the box of the node
+        glm::vec3 t0 = (node.min - origin) * invDirection;
+        glm::vec3 t1 = (node.max - origin) * invDirection;
+        glm::vec3 tMin = glm::min(t0, t1), tMax = glm::max(t0, t1);
+        float tEnter = glm::max(tMin.x, glm::max(tMin.y, tMin.z));
+        float tExit = glm::min(tMax.x, glm::min(tMax.y, tMax.z));
+        if (tExit < glm::max(tEnter, 0.0f) || tEnter > best) {
+            continue;
+        }
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; ++i) {
+                int t = triangleIndices[i];
+                float distance = rayTriangleIntersection(origin, direction, vertices[3 * t], vertices[3 * t + 1], vertices[3 * t + 2]);
+                if (distance >= 0.0f && distance < best) {
+                    best = distance;
+                    triangle = t;
+                }
+            }
+        } else {
+            stack[stackSize++] = node.first;
+            stack[stackSize++] = node.first + 1;
+        }
+    }
+    return triangle >= 0 ? best : -1.0f;
+}
+
+int BVH::countHits(glm::vec3 origin, glm::vec3 direction, const std::vector<glm::vec3>& vertices) const {
+    if (nodes.empty()) {
+        return 0;
+    }
+    int hits = 0;
+    glm::vec3 invDirection = 1.0f / direction;
+    int stack[BVH_MAX_DEPTH + 2];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node& node = nodes[stack[--stackSize]];
+        glm::vec3 t0 = (node.min - origin) * invDirection;
+        glm::vec3 t1 = (node.max - origin) * invDirection;
+        glm::vec3 tMin = glm::min(t0, t1), tMax = glm::max(t0, t1);
+        float tEnter = glm::max(tMin.x, glm::max(tMin.y, tMin.z));
+        float tExit = glm::min(tMax.x, glm::min(tMax.y, tMax.z));
+        if (tExit < glm::max(tEnter, 0.0f)) {
+            continue;
+        }
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; ++i) {
+                int t = triangleIndices[i];
+                hits += rayTriangleIntersection(origin, direction, vertices[3 * t], vertices[3 * t + 1], vertices[3 * t + 2]) > 0.0f ? 1 : 0;
+            }
+        } else {
+            stack[stackSize++] = node.first;
+            stack[stackSize++] = node.first + 1;
+        }
+    }
+    return hits;
+}
+
+static float boxDistance2(glm::vec3 point, glm::vec3 min, glm::vec3 max) {
+    glm::vec3 d = glm::max(glm::max(min - point, point - max), glm::vec3(0.0f));
+    return glm::dot(d, d);
+}
+
+float BVH::closestDistance(glm::vec3 point, const std::vector<glm::vec3>& vertices, float maxDistance) const {
+    float best = maxDistance * maxDistance;
+    if (nodes.empty()) {
+        return maxDistance;
+    }
+    int stack[BVH_MAX_DEPTH + 2];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node& node = nodes[stack[--stackSize]];
+        if (boxDistance2(point, node.min, node.max) >= best) {
+            continue;
+        }
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; ++i) {
+                int t = triangleIndices[i];
+                glm::vec3 d = point - closestPointOnTriangle(point, vertices[3 * t], vertices[3 * t + 1], vertices[3 * t + 2]);
+                best = glm::min(best, glm::dot(d, d));
+            }
+        } else {
+            // the nearest child is visited first, so the farther one is usually pruned
+            int near = node.first, far = node.first + 1;
+            if (boxDistance2(point, nodes[far].min, nodes[far].max) < boxDistance2(point, nodes[near].min, nodes[near].max)) {
+                std::swap(near, far);
+            }
+            stack[stackSize++] = far;
+            stack[stackSize++] = near;
+        }
+    }
+    return std::sqrt(best);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Bounding volume hierarchy over triangles, built with the surface area heuristic
+class BVH {
+
+    public:
+        struct Node {
+            glm::vec3 min;
+            glm::vec3 max;
+            int first; // first child for inner nodes, first triangle for leaves
+            int count; // number of triangles (0 for inner nodes)
+        };
+
+        std::vector<Node> nodes;
+        std::vector<int> triangleIndices; // triangles ordered by leaf
+
+        void build(const std::vector<glm::vec3>& vertices); // 3 vertices per triangle
+        void query(glm::vec3 min, glm::vec3 max, std::vector<int>& triangles) const; // triangles whose box overlaps the given box
+        float raycast(glm::vec3 origin, glm::vec3 direction, const std::vector<glm::vec3>& vertices, int& triangle) const; // closest hit distance, negative if none
+        int countHits(glm::vec3 origin, glm::vec3 direction, const std::vector<glm::vec3>& vertices) const; // triangles crossed by the ray
+        float closestDistance(glm::vec3 point, const std::vector<glm::vec3>& vertices, float maxDistance) const; // distance to the closest triangle, maxDistance if none is closer
+
+    private:
+        std::vector<glm::vec3> triangleMin, triangleMax, centroids; // only used during the build
+
+        void subdivide(int nodeIndex, int depth);
+        void updateBounds(Node& node);
+};
@@ -7,7 +7,7 @@
 #include <cmath>
 
 Camera::Camera(glm::vec3 position, glm::vec3 direction, glm::vec3 up)
-    : position(position), direction(direction), up(up) {}
+    : position(position), direction(direction), up(up), aspectRatio(CAMERA_ASPECT_RATIO) {}
 
 glm::mat4 Camera::getViewMatrix() const {
     return glm::lookAt(position, position + direction, up);
@@ -17,15 +17,12 @@ glm::mat4 Camera::getProjectionMatrix(float fov, float aspect, float near, float
     return glm::perspective(fov, aspect, near, far);
 }
 
-void Camera::loadMatricesIntoShader(GLuint shaderProgram) const {
-    glm::mat4 viewMatrix = getViewMatrix();
-    glm::mat4 projectionMatrix = getProjectionMatrix(CAMERA_FOV, CAMERA_ASPECT_RATIO, CAMERA_NEAR, CAMERA_FAR);
+void Camera::loadMatricesIntoBuffer(GLuint uniformBuffer) const {
+    glm::mat4 matrices[2] = {getViewMatrix(), getProjectionMatrix(CAMERA_FOV, aspectRatio, CAMERA_NEAR, CAMERA_FAR)};
 
-    GLint viewMatrixLocation = glGetUniformLocation(shaderProgram, "viewMatrix");
-    glUniformMatrix4fv(viewMatrixLocation, 1, GL_FALSE, glm::value_ptr(viewMatrix));
-
-    GLint projectionMatrixLocation = glGetUniformLocation(shaderProgram, "projectionMatrix");
-    glUniformMatrix4fv(projectionMatrixLocation, 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+    glBindBuffer(GL_UNIFORM_BUFFER, uniformBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(matrices), matrices);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
 void Camera::moveForward(float distance) {
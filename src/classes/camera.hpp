@@ -9,13 +9,14 @@ public:
     glm::vec3 position;
     glm::vec3 direction;
     glm::vec3 up;
+    float aspectRatio; // width / height of the rendered image
 
     Camera(glm::vec3 position, glm::vec3 direction, glm::vec3 up);
 
     glm::mat4 getViewMatrix() const;
     glm::mat4 getProjectionMatrix(float fov, float aspect, float near, float far) const;
 
-    void loadMatricesIntoShader(GLuint shaderProgram) const;
+    void loadMatricesIntoBuffer(GLuint uniformBuffer) const; // view then projection matrix, std140 layout of the CameraMatrices block of the shaders
     
     void moveForward(float distance);
     void moveInDirection(float distance);
@@ -1,4 +1,5 @@
 #include "container.hpp"
+#include "particle.hpp"
 
 #include <vector>
 #include <glm/glm.hpp>
@@ -6,6 +7,8 @@
 
 Container::Container(glm::vec3 position, bool forcedInside) {
     this->position = position;
+    this->initialPosition = position;
+    this->previousPosition = position;
     this->forcedInside = forcedInside;
 }
 
@@ -14,5 +17,79 @@ glm::vec3 Container::getPosition() {
 }
 
 void Container::setPosition(glm::vec3 position) {
+    // teleporting the container does not push the spheres
     this->position = position;
+    this->initialPosition = position;
+    this->previousPosition = position;
+    version++;
+}
+
+unsigned int Container::getVersion() {
+    return version;
+}
+
+void Container::setRestitution(float restitution) {
+    this->restitution = restitution;
+}
+
+void Container::setFriction(float friction) {
+    this->friction = friction;
+}
+
+void Container::setMotion(std::shared_ptr<KinematicMotion> motion) {
+    this->motion = motion;
+}
+
+bool Container::isKinematic() {
+    return motion != nullptr;
+}
+
+void Container::updateMotion(float time) {
+    if (!motion) {
+        return;
+    }
+    previousPosition = position;
+    previousOrientation = orientation;
+    motion->evaluate(time, initialPosition, position, orientation);
+    version++;
+}
+
+float Container::getMaxWallDisplacement(glm::vec3 min, glm::vec3 max) const {
+    if (!motion) {
+        return 0.0f;
+    }
+    // the displacement is an affine function of the point, its largest length over the box is at a corner
+    float largest = 0.0f;
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 point = glm::vec3(corner & 1 ? max.x : min.x, corner & 2 ? max.y : min.y, corner & 4 ? max.z : min.z);
+        largest = glm::max(largest, glm::length(getWallDisplacement(point)));
+    }
+    return largest;
+}
+
+glm::vec3 Container::toLocal(glm::vec3 point) const {
+    // the transpose of a rotation is its inverse
+    return glm::transpose(orientation) * (point - position);
+}
+
+glm::vec3 Container::toPreviousLocal(glm::vec3 point) const {
+    return glm::transpose(previousOrientation) * (point - previousPosition);
+}
+
+glm::vec3 Container::getWallDisplacement(glm::vec3 point) const {
+    // where the same point of the container was before the last update
+    return point - (previousPosition + previousOrientation * toLocal(point));
+}
+
+void Container::collideWith(const std::vector<Sphere*>& spheres) {
+    const int numSpheres = static_cast<int>(spheres.size());
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < numSpheres; ++i) {
+        collideWith(spheres[i]);
+    }
+}
+
+void Container::applyWallResponse(Sphere* sphere, glm::vec3 unconstrainedPosition, glm::vec3 normal) {
+    glm::vec3 wallDisplacement = motion ? getWallDisplacement(sphere->position) : glm::vec3(0.0f);
+    sphere->applyWallResponse(unconstrainedPosition, normal, restitution, friction, wallDisplacement);
 }
\ No newline at end of file
@@ -4,26 +4,52 @@
 #include <glm/glm.hpp>
 #include <memory>
 #include "particle.hpp"
+#include "kinematicMotion.hpp"
 
 // ? forward declaration
 class Sphere;
 
 class Container {
     protected:
+        unsigned int version = 0; // incremented every time the shape of the container changes (used to refresh its rasterization in the grid)
+        glm::vec3 initialPosition; // position at time 0, the motion is evaluated from it
+        glm::vec3 previousPosition; // pose before the last motion update, to sweep the walls and get their velocity
+        glm::mat3 previousOrientation = glm::mat3(1.0f);
+        std::shared_ptr<KinematicMotion> motion; // null for a static container
         bool forcedInside; // this is used to force the particles inside the container, mainly if the dt in the simulation is high (or not many substeps), but be careful with this, it can lead to some weird behavior if you have multiple containers
 
     public:
         glm::vec3 position;
         glm::vec3 size;
+        glm::mat3 orientation = glm::mat3(1.0f); // rotation of the container around its position (local to world)
+        float restitution = 0.0f; // part of the normal velocity kept after hitting a wall (0 : no bounce, 1 : perfect bounce)
+        float friction = 0.0f; // part of the tangential velocity removed when hitting a wall (0 : no friction, 1 : the sphere sticks)
 
         Container(glm::vec3 position, bool forcedInside = false);
         glm::vec3 getPosition();
         void setPosition(glm::vec3 position);
         bool getForcedInside();
+        unsigned int getVersion();
+        void setRestitution(float restitution);
+        void setFriction(float friction);
+        void setMotion(std::shared_ptr<KinematicMotion> motion);
+        bool isKinematic();
+        void updateMotion(float time); // move the container along its motion, keeping its previous pose
+        float getMaxWallDisplacement(glm::vec3 min, glm::vec3 max) const; // largest displacement of the walls inside a box during the last motion update
 
         virtual void collideWith(Sphere* sphere) = 0;
+        virtual void collideWith(const std::vector<Sphere*>& spheres); // batch version in parallel, used with the spheres of the boundary cells (each sphere once)
+        virtual bool isNearBoundary(glm::vec3 cellMin, glm::vec3 cellMax, float margin) = 0; // whether a sphere in this cell can touch the container
+        virtual void getBounds(glm::vec3& min, glm::vec3& max) = 0; // axis aligned bounding box of the container
+
+    protected:
+        glm::vec3 toLocal(glm::vec3 point) const; // world to container space, with the current pose
+        glm::vec3 toPreviousLocal(glm::vec3 point) const; // world to container space, with the previous pose
+        glm::vec3 getWallDisplacement(glm::vec3 point) const; // displacement of the wall at this point during the last motion update
+        void applyWallResponse(Sphere* sphere, glm::vec3 unconstrainedPosition, glm::vec3 normal); // bounce and friction relative to the wall, by adjusting the previous position
 };
 
 // container classes
 #include "./containers/cubeContainer.hpp"
-#include "./containers/sphereContainer.hpp"
\ No newline at end of file
+#include "./containers/sphereContainer.hpp"
+#include "./containers/meshContainer.hpp"
\ No newline at end of file
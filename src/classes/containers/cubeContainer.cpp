@@ -11,6 +11,7 @@ glm::vec3 CubeContainer::getSize() {
 
 void CubeContainer::setSize(glm::vec3 size) {
     this->size = size;
+    version++;
 }
 
 bool Container::getForcedInside() {
@@ -18,34 +19,77 @@ bool Container::getForcedInside() {
 }
 
 void CubeContainer::collideWith(Sphere* sphere) {
-    // Collision resolution code
-    glm::vec3 spherePosition = sphere->position;
+    collideWith(sphere, size / 2.0f);
+}
+
+void CubeContainer::collideWith(const std::vector<Sphere*>& spheres) {
+    // the calls below are not virtual, a sphere is in a single cell so the batch has no duplicate
+    glm::vec3 halfSize = size / 2.0f;
+    const int numSpheres = static_cast<int>(spheres.size());
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < numSpheres; ++i) {
+        collideWith(spheres[i], halfSize);
+    }
+}
+
+void CubeContainer::getBounds(glm::vec3& min, glm::vec3& max) {
+    // box around the rotated container, its extent along an axis is the sum of the projections of the half sizes
+    glm::vec3 halfSize = size / 2.0f;
+    glm::vec3 extent = glm::abs(orientation[0]) * halfSize.x + glm::abs(orientation[1]) * halfSize.y + glm::abs(orientation[2]) * halfSize.z;
+    min = position - extent; // getting the minimum points of the container
+    max = position + extent; // getting the maximum points of the container
+}
+
+void CubeContainer::collideWith(Sphere* sphere, glm::vec3 halfSize) {
+    // the container acts as an infinite mass, so a movable sphere takes the whole correction and a fixed one none
+    if (sphere->getInverseMass() == 0.0f) {
+        return;
+    }
+
+    // the walls are resolved in the space of the container, so a rotated container works the same way
+    glm::vec3 spherePosition = toLocal(sphere->position);
     float sphereRadius = sphere->radius;
-    glm::vec3 min = position - size / 2.0f; // getting the minimum points of the container
-    glm::vec3 max = position + size / 2.0f; // getting the maximum points of the container
     // Check if the sphere is inside the container
-    if (!forcedInside && !(min.x <= spherePosition.x && spherePosition.x <= max.x && min.y <= spherePosition.y && spherePosition.y <= max.y && min.z <= spherePosition.z && spherePosition.z <= max.z)) {
-        // the sphere is outside the container
-        return;
+    if (!forcedInside && glm::any(glm::greaterThan(glm::abs(spherePosition), halfSize))) {
+        // the sphere is outside the container, but a moving wall may have swept past it during the step
+        if (!motion || glm::any(glm::greaterThan(glm::abs(toPreviousLocal(sphere->position)), halfSize))) {
+            return;
+        }
     }
 
     // Collision resolution code
-    if (spherePosition.x - sphereRadius < min.x) {
-        sphere->position.x = min.x + sphereRadius;
-    } 
-    if (spherePosition.x + sphereRadius > max.x) {
-        sphere->position.x = max.x - sphereRadius;
-    }
-    if (spherePosition.y - sphereRadius < min.y) {
-        sphere->position.y = min.y + sphereRadius;
+    glm::vec3 unconstrainedPosition = sphere->position;
+    glm::vec3 localPosition = spherePosition;
+    glm::vec3 normal = glm::vec3(0.0f); // sum of the normals of the walls that are hit
+    for (int axis = 0; axis < 3; axis++) {
+        if (spherePosition[axis] - sphereRadius < -halfSize[axis]) {
+            localPosition[axis] = -halfSize[axis] + sphereRadius;
+            normal[axis] += 1.0f;
+        }
+        if (spherePosition[axis] + sphereRadius > halfSize[axis]) {
+            localPosition[axis] = halfSize[axis] - sphereRadius;
+            normal[axis] -= 1.0f;
+        }
     }
-    if (spherePosition.y + sphereRadius > max.y) {
-        sphere->position.y = max.y - sphereRadius;
+
+    if (normal != glm::vec3(0.0f)) {
+        sphere->position = position + orientation * localPosition;
+        applyWallResponse(sphere, unconstrainedPosition, glm::normalize(orientation * normal));
     }
-    if (spherePosition.z - sphereRadius < min.z) {
-        sphere->position.z = min.z + sphereRadius;
+}
+
+bool CubeContainer::isNearBoundary(glm::vec3 cellMin, glm::vec3 cellMax, float margin) {
+    // the cell is tested as a sphere around its center, in the space of the container
+    glm::vec3 halfSize = size / 2.0f;
+    glm::vec3 center = glm::abs(toLocal((cellMin + cellMax) / 2.0f));
+    float halfDiagonal = glm::length(cellMax - cellMin) / 2.0f;
+    // the cell is deep inside the container, no sphere in it can reach a wall
+    if (glm::all(glm::lessThanEqual(center + halfDiagonal + margin, halfSize))) {
+        return false;
     }
-    if (spherePosition.z + sphereRadius > max.z) {
-        sphere->position.z = max.z - sphereRadius;
+    // the cell is outside the container, only a forced container pulls the spheres back inside
+    if (!forcedInside && glm::any(glm::greaterThan(center - halfDiagonal - margin, halfSize))) {
+        return false;
     }
-}
\ No newline at end of file
+    return true;
+}
@@ -0,0 +1,275 @@
+#include "meshContainer.hpp"
+#include "../mesh.hpp"
+#include "../bvh.hpp"
+#include "../../utils/geometry.hpp"
+#include "../../utils/file_stamp.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#define SDF_PADDING 2 // samples of padding around the mesh so the gradient stays valid near the surface
+
+MeshContainer::MeshContainer(glm::vec3 position, const std::string& path, int resolution, float scale, bool forcedInside) : Container(position, forcedInside) {
+    this->path = path;
+    this->resolution = resolution;
+    this->size = glm::vec3(scale); // used as the scale of the mesh when rendering
+
+    std::string cachePath = path + ".sdf";
+    if (!loadCache(cachePath)) {
+        std::cout << "Baking the distance field of " << path << " (resolution " << resolution << ")" << std::endl;
+        bake();
+        saveCache(cachePath);
+    }
+}
+
+std::string MeshContainer::getPath() {
+    return path;
+}
+
+void MeshContainer::bake() {
+    std::vector<Vertex> vertices;
+    Mesh::loadFromFile(path, vertices);
+    if (vertices.size() < 3) {
+        std::cerr << "Mesh container: no triangle found in " << path << std::endl;
+        sdfOrigin = glm::vec3(0.0f);
+        sdfDims = glm::ivec3(0);
+        sdfSpacing = 1.0f;
+        sdf.clear();
+        return;
+    }
+
+    std::vector<glm::vec3> points(vertices.size());
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        points[i] = vertices[i].position * size.x;
+        min = glm::min(min, points[i]);
+        max = glm::max(max, points[i]);
+    }
+
+    glm::vec3 extent = max - min;
+    sdfSpacing = glm::max(extent.x, glm::max(extent.y, extent.z)) / static_cast<float>(glm::max(resolution - 1, 1));
+    sdfOrigin = min - glm::vec3(SDF_PADDING * sdfSpacing);
+    sdfDims = glm::ivec3(glm::ceil(extent / sdfSpacing)) + glm::ivec3(1 + 2 * SDF_PADDING);
+    sdf.assign(static_cast<size_t>(sdfDims.x) * sdfDims.y * sdfDims.z, 0.0f);
+
+    // the distance and the crossings are queried in a BVH of the triangles instead of testing all of them per sample
+    BVH bvh;
+    bvh.build(points);
+
+    // skewed directions so that a ray rarely hits an edge exactly, a sample is inside when most rays cross the mesh an odd number of times
+    // (a single ray gets the sign wrong when it grazes an edge or leaves through a hole of a mesh that is not watertight)
+    const glm::vec3 rayDirections[3] = {
+        glm::normalize(glm::vec3(0.5773f, 0.5771f, 0.5776f)),
+        glm::normalize(glm::vec3(-0.8164f, 0.4083f, 0.4087f)),
+        glm::normalize(glm::vec3(0.1219f, -0.7071f, 0.6966f))
+    };
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int z = 0; z < sdfDims.z; ++z) {
+        for (int y = 0; y < sdfDims.y; ++y) {
+            float previous = std::numeric_limits<float>::max(); // distance of the previous sample of the row
+            for (int x = 0; x < sdfDims.x; ++x) {
+                glm::vec3 p = sdfOrigin + glm::vec3(x, y, z) * sdfSpacing;
+                // the distance changes by at most the spacing between two neighbor samples, which bounds the search
+                float bound = previous < std::numeric_limits<float>::max() ? previous + sdfSpacing * 1.001f : std::numeric_limits<float>::max();
+                float distance = bvh.closestDistance(p, points, bound);
+                previous = distance;
+                int inside = 0;
+                for (const glm::vec3& direction : rayDirections) {
+                    inside += bvh.countHits(p, direction, points) & 1;
+                }
+                sdf[(static_cast<size_t>(z) * sdfDims.y + y) * sdfDims.x + x] = inside >= 2 ? -distance : distance;
+            }
+        }
+    }
+}
+
+// header of the cache file, the cache is rebuilt if any of the fields doesn't match the current model and parameters
+struct SdfCacheHeader {
+    char magic[4];
+    int32_t resolution;
+    float scale;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    int32_t dims[3];
+    float origin[3];
+    float spacing;
+};
+
+bool MeshContainer::loadCache(const std::string& cachePath) {
+    std::ifstream file(cachePath, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    SdfCacheHeader header;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || !getSourceStamp(path, sourceSize, sourceTime)) {
+        return false;
+    }
+    if (std::memcmp(header.magic, "SDF2", 4) != 0 || header.resolution != resolution || header.scale != size.x
+        || header.sourceSize != sourceSize || header.sourceTime != sourceTime) {
+        return false;
+    }
+
+    // a damaged file can still have the right stamp: the dims must be the ones bake gives at this resolution (one more for the rounding)
+    // and the samples must fill the rest of the file exactly
+    const int maxDim = glm::max(resolution - 1, 1) + 2 + 2 * SDF_PADDING;
+    for (int i = 0; i < 3; ++i) {
+        if (header.dims[i] < 1 || header.dims[i] > maxDim) {
+            return false;
+        }
+    }
+    if (!std::isfinite(header.spacing) || header.spacing <= 0.0f) {
+        return false;
+    }
+    size_t numSamples = static_cast<size_t>(header.dims[0]) * header.dims[1] * header.dims[2];
+    std::streamoff dataStart = file.tellg();
+    file.seekg(0, std::ios::end);
+    if (!file || file.tellg() - dataStart != static_cast<std::streamoff>(numSamples * sizeof(float))) {
+        return false;
+    }
+    file.seekg(dataStart);
+
+    std::vector<float> samples(numSamples);
+    if (!file.read(reinterpret_cast<char*>(samples.data()), samples.size() * sizeof(float))) {
+        return false;
+    }
+    sdf.swap(samples);
+    sdfDims = glm::ivec3(header.dims[0], header.dims[1], header.dims[2]);
+    sdfOrigin = glm::vec3(header.origin[0], header.origin[1], header.origin[2]);
+    sdfSpacing = header.spacing;
+    return true;
+}
+
+void MeshContainer::saveCache(const std::string& cachePath) {
+    SdfCacheHeader header;
+    std::memcpy(header.magic, "SDF2", 4);
+    header.resolution = resolution;
+    header.scale = size.x;
+    if (sdf.empty() || !getSourceStamp(path, header.sourceSize, header.sourceTime)) {
+        return;
+    }
+    for (int i = 0; i < 3; ++i) {
+        header.dims[i] = sdfDims[i];
+        header.origin[i] = sdfOrigin[i];
+    }
+    header.spacing = sdfSpacing;
+
+    bool written = writeCacheFile(cachePath, [&](std::ofstream& file) {
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(sdf.data()), sdf.size() * sizeof(float));
+    });
+    if (!written) {
+        std::cerr << "Could not write the distance field cache: " << cachePath << std::endl;
+    }
+}
+
+float MeshContainer::sampleAt(glm::ivec3 index) const {
+    return sdf[(static_cast<size_t>(index.z) * sdfDims.y + index.y) * sdfDims.x + index.x];
+}
+
+float MeshContainer::sample(glm::vec3 localPosition, glm::vec3& gradient) const {
+    if (sdf.empty()) {
+        gradient = glm::vec3(0.0f);
+        return std::numeric_limits<float>::max();
+    }
+
+    // clamp to the field, the distance to the field box is added for the points outside of it
+    glm::vec3 gridPosition = (localPosition - sdfOrigin) / sdfSpacing;
+    glm::vec3 clamped = glm::clamp(gridPosition, glm::vec3(0.0f), glm::vec3(sdfDims - glm::ivec3(1)) - glm::vec3(1e-4f));
+    float outside = glm::length(gridPosition - clamped) * sdfSpacing;
+
+    glm::ivec3 i = glm::ivec3(glm::floor(clamped));
+    glm::vec3 f = clamped - glm::vec3(i);
+    float c000 = sampleAt(i);
+    float c100 = sampleAt(i + glm::ivec3(1, 0, 0));
+    float c010 = sampleAt(i + glm::ivec3(0, 1, 0));
+    float c110 = sampleAt(i + glm::ivec3(1, 1, 0));
+    float c001 = sampleAt(i + glm::ivec3(0, 0, 1));
+    float c101 = sampleAt(i + glm::ivec3(1, 0, 1));
+    float c011 = sampleAt(i + glm::ivec3(0, 1, 1));
+    float c111 = sampleAt(i + glm::ivec3(1, 1, 1));
+
+    float c00 = glm::mix(c000, c100, f.x), c10 = glm::mix(c010, c110, f.x);
+    float c01 = glm::mix(c001, c101, f.x), c11 = glm::mix(c011, c111, f.x);
+    float c0 = glm::mix(c00, c10, f.y), c1 = glm::mix(c01, c11, f.y);
+
+    // analytic gradient of the trilinear interpolation, from the same 8 samples
+    gradient.x = glm::mix(glm::mix(c100 - c000, c110 - c010, f.y), glm::mix(c101 - c001, c111 - c011, f.y), f.z);
+    gradient.y = glm::mix(c10 - c00, c11 - c01, f.z);
+    gradient.z = c1 - c0;
+    gradient /= sdfSpacing;
+
+    return glm::mix(c0, c1, f.z) + outside;
+}
+
+void MeshContainer::collideWith(Sphere* sphere) {
+    // the container acts as an infinite mass, so a movable sphere takes the whole correction and a fixed one none
+    if (sphere->getInverseMass() == 0.0f) {
+        return;
+    }
+
+    glm::vec3 gradient;
+    float distance = sample(toLocal(sphere->position), gradient);
+
+    // Check if the sphere is inside the container
+    if (!forcedInside && distance > 0.0f) {
+        // the sphere is outside the container, but a moving wall may have swept past it during the step
+        glm::vec3 previousGradient;
+        if (!motion || sample(toPreviousLocal(sphere->position), previousGradient) > 0.0f) {
+            return;
+        }
+    }
+
+    // Collision resolution code
+    float penetration = distance + sphere->radius;
+    float gradientLength = glm::length(gradient);
+    if (penetration > 0.0f && gradientLength > 1e-6f) {
+        glm::vec3 unconstrainedPosition = sphere->position;
+        glm::vec3 normal = orientation * (-gradient / gradientLength); // pointing towards the inside of the mesh
+        sphere->position += penetration * normal;
+        applyWallResponse(sphere, unconstrainedPosition, normal);
+    }
+}
+
+void MeshContainer::collideWith(const std::vector<Sphere*>& spheres) {
+    const int numSpheres = static_cast<int>(spheres.size());
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < numSpheres; ++i) {
+        MeshContainer::collideWith(spheres[i]); // qualified call, no virtual dispatch
+    }
+}
+
+bool MeshContainer::isNearBoundary(glm::vec3 cellMin, glm::vec3 cellMax, float margin) {
+    glm::vec3 gradient;
+    float distance = sample(toLocal((cellMin + cellMax) / 2.0f), gradient);
+    float halfDiagonal = glm::length(cellMax - cellMin) / 2.0f;
+    // the cell is deep inside the container, no sphere in it can reach the surface
+    if (distance + halfDiagonal < -margin) {
+        return false;
+    }
+    // the cell is outside the container, only a forced container pulls the spheres back inside
+    if (!forcedInside && distance - halfDiagonal > margin) {
+        return false;
+    }
+    return true;
+}
+
+void MeshContainer::getBounds(glm::vec3& min, glm::vec3& max) {
+    // box around the rotated field
+    glm::vec3 localMin = sdfOrigin;
+    glm::vec3 localMax = sdfOrigin + glm::vec3(glm::max(sdfDims - glm::ivec3(1), glm::ivec3(0))) * sdfSpacing;
+    glm::vec3 center = position + orientation * ((localMin + localMax) / 2.0f);
+    glm::vec3 halfSize = (localMax - localMin) / 2.0f;
+    glm::vec3 extent = glm::abs(orientation[0]) * halfSize.x + glm::abs(orientation[1]) * halfSize.y + glm::abs(orientation[2]) * halfSize.z;
+    min = center - extent;
+    max = center + extent;
+}
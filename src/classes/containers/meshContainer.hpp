@@ -0,0 +1,34 @@
+#pragma once
+#include "../container.hpp"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Container shaped by a closed OBJ mesh, the spheres are kept inside it
+// The mesh is baked into a signed distance field (negative inside) which is cached on disk next to the model
+class MeshContainer final : public Container {
+    private:
+        std::string path; // path of the OBJ file
+        int resolution; // number of samples of the distance field along its longest axis
+        glm::vec3 sdfOrigin; // position of the first sample (relative to the container position)
+        glm::ivec3 sdfDims; // number of samples along each axis
+        float sdfSpacing; // distance between two samples
+        std::vector<float> sdf;
+
+        void bake(); // compute the distance field from the triangles of the mesh
+        bool loadCache(const std::string& cachePath);
+        void saveCache(const std::string& cachePath);
+        float sampleAt(glm::ivec3 index) const;
+        float sample(glm::vec3 localPosition, glm::vec3& gradient) const; // trilinear distance and its gradient
+
+    public:
+
+        MeshContainer(glm::vec3 position, const std::string& path, int resolution = 64, float scale = 1.0f, bool forcedInside = false);
+        std::string getPath();
+
+        using Container::collideWith;
+        void collideWith(Sphere* sphere) override;
+        void collideWith(const std::vector<Sphere*>& spheres) override;
+        bool isNearBoundary(glm::vec3 cellMin, glm::vec3 cellMax, float margin) override;
+        void getBounds(glm::vec3& min, glm::vec3& max) override;
+};
@@ -11,9 +11,28 @@ glm::vec3 SphereContainer::getSize() {
 
 void SphereContainer::setSize(glm::vec3 size) {
     this->size = size;
+    version++;
+}
+
+void SphereContainer::collideWith(const std::vector<Sphere*>& spheres) {
+    const int numSpheres = static_cast<int>(spheres.size());
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < numSpheres; ++i) {
+        SphereContainer::collideWith(spheres[i]); // qualified call, no virtual dispatch
+    }
+}
+
+void SphereContainer::getBounds(glm::vec3& min, glm::vec3& max) {
+    min = position - glm::vec3(size.x);
+    max = position + glm::vec3(size.x);
 }
 
 void SphereContainer::collideWith(Sphere* sphere) {
+    // the container acts as an infinite mass, so a movable sphere takes the whole correction and a fixed one none
+    if (sphere->getInverseMass() == 0.0f) {
+        return;
+    }
+
     // Collision resolution code
     glm::vec3 spherePosition = sphere->position;
     float sphereRadius = sphere->radius;
@@ -24,8 +43,10 @@ void SphereContainer::collideWith(Sphere* sphere) {
     
     // Check if the sphere is inside the container
     if (!forcedInside && distance > radius) {
-        // the sphere is outside the container
-        return;
+        // the sphere is outside the container, but a moving wall may have swept past it during the step
+        if (!motion || glm::length(spherePosition - previousPosition) > radius) {
+            return;
+        }
     }
 
     // Collision resolution code
@@ -33,6 +54,24 @@ void SphereContainer::collideWith(Sphere* sphere) {
         // Calculate the penetration depth
         float penetration = distance + sphereRadius - radius;
         // Calculate the new position of the sphere
-        sphere->position -= penetration * glm::normalize(axis);
+        glm::vec3 unconstrainedPosition = sphere->position;
+        glm::vec3 normal = -glm::normalize(axis); // pointing towards the center of the container
+        sphere->position += penetration * normal;
+        applyWallResponse(sphere, unconstrainedPosition, normal);
+    }
+}
+
+bool SphereContainer::isNearBoundary(glm::vec3 cellMin, glm::vec3 cellMax, float margin) {
+    float radius = size.x;
+    glm::vec3 closest = glm::clamp(position, cellMin, cellMax);
+    glm::vec3 farthest = glm::max(glm::abs(cellMin - position), glm::abs(cellMax - position));
+    // the cell is deep inside the container, no sphere in it can reach the wall
+    if (glm::length(farthest) < radius - margin) {
+        return false;
+    }
+    // the cell is outside the container, only a forced container pulls the spheres back inside
+    if (!forcedInside && glm::length(closest - position) > radius + margin) {
+        return false;
     }
+    return true;
 }
\ No newline at end of file
@@ -2,12 +2,17 @@
 #include "../container.hpp"
 #include <glm/glm.hpp>
 
-class SphereContainer : public Container {
+class SphereContainer final : public Container {
     public:
 
         SphereContainer(glm::vec3 position, glm::vec3 size, bool forcedInside = false);
         glm::vec3 getSize();
         void setSize(glm::vec3 size);
 
+        using Container::collideWith;
         void collideWith(Sphere* sphere) override;
+        void collideWith(const std::vector<Sphere*>& spheres) override;
+        bool isNearBoundary(glm::vec3 cellMin, glm::vec3 cellMax, float margin) override;
+        void getBounds(glm::vec3& min, glm::vec3& max) override;
+
 };
\ No newline at end of file
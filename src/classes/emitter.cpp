@@ -0,0 +1,47 @@
+#include "emitter.hpp"
+#include <glm/glm.hpp>
+#include "particle.hpp"
+#include "../config.hpp"
+#include <memory>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+Emitter::Emitter(glm::vec3 position, unsigned int seed) : generator(seed) {
+    this->position = position;
+}
+
+int Emitter::getEmitCount(float dt) {
+    if (!enabled) {
+        return 0;
+    }
+    accumulator += rate * dt;
+    int count = static_cast<int>(accumulator);
+    accumulator -= static_cast<float>(count);
+    return count;
+}
+
+std::shared_ptr<Sphere> Emitter::emit(float dt) {
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    // uniform direction in the cone, around its axis
+    glm::vec3 axis = glm::normalize(direction);
+    glm::vec3 reference = std::abs(axis.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 u = glm::normalize(glm::cross(axis, reference));
+    glm::vec3 v = glm::cross(axis, u);
+    float cosAngle = 1.0f - uniform(generator) * (1.0f - std::cos(glm::radians(coneAngle)));
+    float sinAngle = std::sqrt(std::max(1.0f - cosAngle * cosAngle, 0.0f));
+    float phi = 2.0f * 3.14159265358979f * uniform(generator);
+    glm::vec3 velocity = (axis * cosAngle + (u * std::cos(phi) + v * std::sin(phi)) * sinAngle) * speed;
+
+    // uniform point on the disc
+    float distance = spawnRadius * std::sqrt(uniform(generator));
+    float theta = 2.0f * 3.14159265358979f * uniform(generator);
+    glm::vec3 start = position + (u * std::cos(theta) + v * std::sin(theta)) * distance;
+
+    float radius = std::min(minRadius + (maxRadius - minRadius) * uniform(generator), MAX_PARTICLE_RADIUS); // the grid cells can't hold bigger spheres
+    std::shared_ptr<Sphere> sphere = std::make_shared<Sphere>(start, radius, velocity, glm::vec3(0.0f), false);
+    sphere->previous_position = start - velocity * dt; // with Verlet integration the velocity is the displacement since the previous position
+    sphere->setMass(mass);
+    return sphere;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include "particle.hpp"
+#include <memory>
+#include <random>
+
+// Source of new spheres, shot at a constant rate in a cone
+class Emitter {
+
+    private:
+        float accumulator = 0.0f; // fraction of sphere left over from the previous steps
+        std::mt19937 generator;
+
+    public:
+        glm::vec3 position;
+        glm::vec3 direction = glm::vec3(0.0f, 1.0f, 0.0f); // axis of the cone
+        float spawnRadius = 0.0f; // the spheres start on a disc of this radius around the position (orthogonal to the direction), so they don't overlap
+        float coneAngle = 15.0f; // half angle of the cone, in degrees
+        float speed = 5.0f;
+        float rate = 50.0f; // spheres per second
+        float minRadius = 0.1f; // the radius is uniform between the two (at most MAX_PARTICLE_RADIUS)
+        float maxRadius = 0.1f;
+        float mass = 1.0f;
+        bool enabled = true;
+
+        Emitter(glm::vec3 position, unsigned int seed = 0);
+        int getEmitCount(float dt); // number of spheres to emit during this step
+        std::shared_ptr<Sphere> emit(float dt); // a new sphere, its velocity is set through its previous position
+};
@@ -0,0 +1,276 @@
+#include "fluid.hpp"
+#include <glm/glm.hpp>
+#include "particle.hpp"
+#include "grid.hpp"
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+#define FLUID_PI 3.14159265358979f
+
+Fluid::Fluid(float restDensity, float smoothingRadius, float viscosity, int iterations) {
+    this->restDensity = restDensity;
+    this->smoothingRadius = smoothingRadius;
+    this->viscosity = viscosity;
+    this->iterations = iterations;
+}
+
+void Fluid::addSphere(std::shared_ptr<Sphere> sphere) {
+    sphere->fluid = this;
+    sphere->fluidIndex = static_cast<int>(spheres.size());
+    spheres.push_back(sphere);
+}
+
+float Fluid::getDensity(int index) const {
+    return density[index];
+}
+
+void Fluid::setup(const Grid& grid) {
+    float radius = spheres[0]->radius;
+    float cellSize = grid.getCellSize();
+    if (smoothingRadius <= 0.0f) {
+        smoothingRadius = 4.0f * radius;
+    }
+    // the neighbors are only searched in the 27 cells around the particle
+    if (smoothingRadius > cellSize) {
+        std::cerr << "Fluid smoothing radius " << smoothingRadius << " is larger than a grid cell, clamped to " << cellSize << std::endl;
+        smoothingRadius = cellSize;
+    }
+    if (restDensity <= 0.0f) {
+        // density of a particle in a cubic lattice of spheres touching each other
+        float h = smoothingRadius;
+        float poly6 = 315.0f / (64.0f * FLUID_PI * std::pow(h, 9.0f));
+        float spacing = 2.0f * radius;
+        int steps = static_cast<int>(std::ceil(h / spacing));
+        restDensity = 0.0f;
+        for (int i = -steps; i <= steps; i++) {
+            for (int j = -steps; j <= steps; j++) {
+                for (int k = -steps; k <= steps; k++) {
+                    float r2 = (i * i + j * j + k * k) * spacing * spacing;
+                    if (r2 < h * h) {
+                        restDensity += spheres[0]->mass * poly6 * std::pow(h * h - r2, 3.0f);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void Fluid::gather() {
+    const int n = static_cast<int>(spheres.size());
+    x.resize(n); y.resize(n); z.resize(n);
+    nextX.resize(n); nextY.resize(n); nextZ.resize(n);
+    mass.resize(n);
+    density.resize(n);
+    lambda.resize(n);
+    neighborCount.resize(n);
+    neighbors.resize(static_cast<size_t>(n) * FLUID_MAX_NEIGHBORS);
+    std::fill(neighborCount.begin(), neighborCount.end(), 0);
+    #pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        glm::vec3 p = spheres[i]->position;
+        x[i] = p.x; y[i] = p.y; z[i] = p.z;
+        mass[i] = spheres[i]->mass;
+    }
+}
+
+void Fluid::findNeighbors(const Grid& grid) {
+    const float h2 = smoothingRadius * smoothingRadius;
+    // the candidates of the 27 cells are gathered once per cell and shared by all the particles of the cell
+    std::vector<const std::vector<std::shared_ptr<Sphere>>*> cells;
+    std::vector<glm::ivec3> keys;
+    for (auto& entry : grid.grid) {
+        keys.push_back(entry.first);
+        cells.push_back(&entry.second);
+    }
+    const int numCells = static_cast<int>(cells.size());
+    #pragma omp parallel
+    {
+        std::vector<int> candidates;
+        std::vector<float> cx, cy, cz;
+        #pragma omp for schedule(dynamic, 4)
+        for (int c = 0; c < numCells; c++) {
+            bool hasFluid = false;
+            for (auto& s : *cells[c]) {
+                hasFluid |= s->fluid == this;
+            }
+            if (!hasFluid) {
+                continue;
+            }
+            candidates.clear();
+            for (int ox = -1; ox <= 1; ++ox) {
+                for (int oy = -1; oy <= 1; ++oy) {
+                    for (int oz = -1; oz <= 1; ++oz) {
+                        const std::vector<std::shared_ptr<Sphere>>* content = grid.getCellContent(keys[c] + glm::ivec3(ox, oy, oz));
+                        if (content == nullptr) {
+                            continue;
+                        }
+                        for (auto& s : *content) {
+                            if (s->fluid == this) {
+                                candidates.push_back(s->fluidIndex);
+                            }
+                        }
+                    }
+                }
+            }
+            const int numCandidates = static_cast<int>(candidates.size());
+            cx.resize(numCandidates); cy.resize(numCandidates); cz.resize(numCandidates);
+            for (int k = 0; k < numCandidates; k++) {
+                cx[k] = x[candidates[k]]; cy[k] = y[candidates[k]]; cz[k] = z[candidates[k]];
+            }
+
+            for (auto& s : *cells[c]) {
+                if (s->fluid != this) {
+                    continue;
+                }
+                int i = s->fluidIndex;
+                int* list = &neighbors[static_cast<size_t>(i) * FLUID_MAX_NEIGHBORS];
+                int count = 0;
+                for (int k = 0; k < numCandidates && count < FLUID_MAX_NEIGHBORS; k++) {
+                    float dx = cx[k] - x[i], dy = cy[k] - y[i], dz = cz[k] - z[i];
+                    if (dx * dx + dy * dy + dz * dz < h2 && candidates[k] != i) {
+                        list[count++] = candidates[k];
+                    }
+                }
+                neighborCount[i] = count;
+            }
+        }
+    }
+}
+
+void Fluid::computeDensities() {
+    const int n = static_cast<int>(spheres.size());
+    const float h = smoothingRadius;
+    const float h2 = h * h;
+    const float poly6 = 315.0f / (64.0f * FLUID_PI * std::pow(h, 9.0f));
+    const float spiky = -45.0f / (FLUID_PI * std::pow(h, 6.0f));
+    const float inverseRestDensity = 1.0f / restDensity;
+    #pragma omp parallel for schedule(static, 64)
+    for (int i = 0; i < n; i++) {
+        const int* list = &neighbors[static_cast<size_t>(i) * FLUID_MAX_NEIGHBORS];
+        const int count = neighborCount[i];
+        const float xi = x[i], yi = y[i], zi = z[i];
+        float rho = mass[i] * poly6 * h2 * h2 * h2; // the particle itself
+        float gradientSum2 = 0.0f; // sum of the squared gradients of the constraint with respect to the neighbors
+        float gx = 0.0f, gy = 0.0f, gz = 0.0f; // gradient with respect to the particle itself
+        #pragma omp simd reduction(+: rho, gradientSum2, gx, gy, gz)
+        for (int k = 0; k < count; k++) {
+            int j = list[k];
+            float dx = xi - x[j], dy = yi - y[j], dz = zi - z[j];
+            float r2 = std::min(dx * dx + dy * dy + dz * dz, h2);
+            float q = h2 - r2;
+            rho += mass[j] * poly6 * q * q * q;
+            float r = std::sqrt(r2);
+            float w = mass[j] * inverseRestDensity * spiky * (h - r) * (h - r) / std::max(r, 1e-6f);
+            gradientSum2 += w * w * r2;
+            gx += w * dx; gy += w * dy; gz += w * dz;
+        }
+        density[i] = rho;
+        // only compressed particles are pushed apart, the free surface doesn't pull the particles together
+        float constraint = std::max(rho * inverseRestDensity - 1.0f, 0.0f);
+        lambda[i] = -constraint / (gradientSum2 + gx * gx + gy * gy + gz * gz + relaxation);
+    }
+}
+
+void Fluid::computeCorrections() {
+    const int n = static_cast<int>(spheres.size());
+    const float h = smoothingRadius;
+    const float h2 = h * h;
+    const float spiky = -45.0f / (FLUID_PI * std::pow(h, 6.0f));
+    const float inverseRestDensity = 1.0f / restDensity;
+    #pragma omp parallel for schedule(static, 64)
+    for (int i = 0; i < n; i++) {
+        const int* list = &neighbors[static_cast<size_t>(i) * FLUID_MAX_NEIGHBORS];
+        const int count = neighborCount[i];
+        const float xi = x[i], yi = y[i], zi = z[i];
+        const float li = lambda[i];
+        float cx = 0.0f, cy = 0.0f, cz = 0.0f;
+        #pragma omp simd reduction(+: cx, cy, cz)
+        for (int k = 0; k < count; k++) {
+            int j = list[k];
+            float dx = xi - x[j], dy = yi - y[j], dz = zi - z[j];
+            float r2 = std::min(dx * dx + dy * dy + dz * dz, h2);
+            float r = std::sqrt(r2);
+            float w = (li + lambda[j]) * mass[j] * inverseRestDensity * spiky * (h - r) * (h - r) / std::max(r, 1e-6f);
+            cx += w * dx; cy += w * dy; cz += w * dz;
+        }
+        // a fixed particle keeps its position but still pushes the others
+        float moves = spheres[i]->getInverseMass() > 0.0f ? 1.0f : 0.0f;
+        nextX[i] = xi + cx * moves;
+        nextY[i] = yi + cy * moves;
+        nextZ[i] = zi + cz * moves;
+    }
+    // every particle was corrected from the same positions (Jacobi), they can now be swapped in
+    x.swap(nextX);
+    y.swap(nextY);
+    z.swap(nextZ);
+}
+
+void Fluid::applyViscosity() {
+    const int n = static_cast<int>(spheres.size());
+    const float h2 = smoothingRadius * smoothingRadius;
+    const float poly6 = 315.0f / (64.0f * FLUID_PI * std::pow(smoothingRadius, 9.0f));
+    // with Verlet integration the velocity is the displacement since the previous position
+    // the new velocities are written in next* so every particle blends the old velocities of its neighbors
+    #pragma omp parallel for schedule(static, 64)
+    for (int i = 0; i < n; i++) {
+        const int* list = &neighbors[static_cast<size_t>(i) * FLUID_MAX_NEIGHBORS];
+        glm::vec3 vi = spheres[i]->position - spheres[i]->previous_position;
+        glm::vec3 blend = glm::vec3(0.0f);
+        for (int k = 0; k < neighborCount[i]; k++) {
+            int j = list[k];
+            glm::vec3 d = spheres[i]->position - spheres[j]->position;
+            float q = std::max(h2 - glm::dot(d, d), 0.0f);
+            glm::vec3 vj = spheres[j]->position - spheres[j]->previous_position;
+            blend += (vj - vi) * (mass[j] / std::max(density[j], 1e-6f) * poly6 * q * q * q);
+        }
+        glm::vec3 v = vi + viscosity * blend;
+        nextX[i] = v.x; nextY[i] = v.y; nextZ[i] = v.z;
+    }
+    #pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        if (spheres[i]->getInverseMass() > 0.0f) {
+            spheres[i]->previous_position = spheres[i]->position - glm::vec3(nextX[i], nextY[i], nextZ[i]);
+        }
+    }
+}
+
+void Fluid::solve(const Grid& grid) {
+    if (spheres.empty()) {
+        return;
+    }
+    if (!initialized) {
+        setup(grid);
+        initialized = true;
+    }
+    gather();
+    findNeighbors(grid);
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        computeDensities();
+        computeCorrections();
+    }
+    const int n = static_cast<int>(spheres.size());
+    #pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        spheres[i]->position = glm::vec3(x[i], y[i], z[i]);
+    }
+    if (viscosity > 0.0f) {
+        applyViscosity();
+    }
+}
+
+bool Fluid::removeMarkedSpheres() {
+    // swap with the last sphere, so only the moved sphere gets a new index
+    for (int i = 0; i < static_cast<int>(spheres.size());) {
+        if (spheres[i]->removed) {
+            spheres[i] = spheres.back();
+            spheres[i]->fluidIndex = i;
+            spheres.pop_back();
+        } else {
+            i++;
+        }
+    }
+    return spheres.empty();
+}
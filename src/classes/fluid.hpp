@@ -0,0 +1,47 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include "particle.hpp"
+#include "grid.hpp"
+#include <vector>
+#include <memory>
+
+#define FLUID_MAX_NEIGHBORS 64 // neighbors kept per particle, the others are ignored
+
+// Group of spheres behaving as a fluid (position based fluids)
+// The SPH density of every particle is kept at the rest density by moving the positions, like the links of the molecules,
+// and the XSPH viscosity blends the velocities of the neighbors
+class Fluid {
+
+    private:
+        // structure of arrays of the particles, gathered at every solve
+        std::vector<float> x, y, z;
+        std::vector<float> nextX, nextY, nextZ;
+        std::vector<float> mass;
+        std::vector<float> density;
+        std::vector<float> lambda; // scaling factor of the density constraint
+        std::vector<int> neighborCount;
+        std::vector<int> neighbors; // FLUID_MAX_NEIGHBORS per particle, found once and shared by all the passes
+        bool initialized = false; // the default parameters are computed at the first solve
+
+        void setup(const Grid& grid);
+        void gather();
+        void findNeighbors(const Grid& grid);
+        void computeDensities();
+        void computeCorrections();
+        void applyViscosity();
+
+    public:
+        float restDensity = 0.0f; // 0 : the density of the spheres packed at twice their radius
+        float smoothingRadius = 0.0f; // 0 : 4 times the radius of the spheres (at most a cell of the grid)
+        float viscosity = 0.01f; // part of the relative velocity of the neighbors blended in at every step
+        float relaxation = 10.0f; // softens the density constraint, higher is more stable but more compressible
+        int iterations = 3;
+        std::vector<std::shared_ptr<Sphere>> spheres;
+
+        Fluid(float restDensity = 0.0f, float smoothingRadius = 0.0f, float viscosity = 0.01f, int iterations = 3);
+        void addSphere(std::shared_ptr<Sphere> sphere);
+        void solve(const Grid& grid); // the grid has to contain the spheres
+        bool removeMarkedSpheres(); // forget the spheres removed from the simulation, returns whether the fluid is now empty
+        float getDensity(int index) const; // density of a particle at the last solve
+};
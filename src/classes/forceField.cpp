@@ -0,0 +1,110 @@
+#include "forceField.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+void FieldBatch::resize(int n) {
+    x.resize(n); y.resize(n); z.resize(n);
+    vx.resize(n); vy.resize(n); vz.resize(n);
+    ax.resize(n); ay.resize(n); az.resize(n);
+}
+
+ForceField::ForceField(Type type) {
+    this->type = type;
+}
+
+bool ForceField::isBounded() const {
+    return hasRegion || ((type == ATTRACTOR || type == VORTEX) && radius > 0.0f);
+}
+
+void ForceField::getBounds(glm::vec3& min, glm::vec3& max) const {
+    min = glm::vec3(-std::numeric_limits<float>::max());
+    max = glm::vec3(std::numeric_limits<float>::max());
+    if ((type == ATTRACTOR || type == VORTEX) && radius > 0.0f) {
+        glm::vec3 extent = glm::vec3(radius);
+        if (type == VORTEX) {
+            // the support of a vortex is a cylinder, unbounded along every axis its own axis is not orthogonal to
+            glm::vec3 a = glm::abs(glm::normalize(axis));
+            for (int i = 0; i < 3; i++) {
+                if (a[i] > 1e-6f) {
+                    extent[i] = std::numeric_limits<float>::max();
+                }
+            }
+        }
+        min = glm::max(min, position - extent);
+        max = glm::min(max, position + extent);
+    }
+    if (hasRegion) {
+        min = glm::max(min, regionMin);
+        max = glm::min(max, regionMax);
+    }
+}
+
+void ForceField::apply(FieldBatch& batch, int n) const {
+    const float* x = batch.x.data(); const float* y = batch.y.data(); const float* z = batch.z.data();
+    const float* vx = batch.vx.data(); const float* vy = batch.vy.data(); const float* vz = batch.vz.data();
+    float* ax = batch.ax.data(); float* ay = batch.ay.data(); float* az = batch.az.data();
+    const float radius2 = radius > 0.0f ? radius * radius : std::numeric_limits<float>::max();
+    const glm::vec3 rmin = hasRegion ? regionMin : glm::vec3(-std::numeric_limits<float>::max());
+    const glm::vec3 rmax = hasRegion ? regionMax : glm::vec3(std::numeric_limits<float>::max());
+
+    // the type is tested once for the whole batch, the loops only keep the region tests as masks
+    switch (type) {
+        case ATTRACTOR: {
+            const float px = position.x, py = position.y, pz = position.z;
+            const float s = strength;
+            const float square = inverseSquare ? 1.0f : 0.0f;
+            #pragma omp simd
+            for (int i = 0; i < n; i++) {
+                float dx = px - x[i], dy = py - y[i], dz = pz - z[i];
+                float d2 = dx * dx + dy * dy + dz * dz;
+                float inside = static_cast<float>(d2 < radius2) * static_cast<float>(x[i] >= rmin.x && x[i] <= rmax.x && y[i] >= rmin.y && y[i] <= rmax.y && z[i] >= rmin.z && z[i] <= rmax.z);
+                float d = std::sqrt(std::max(d2, 1e-8f));
+                // constant or inverse square magnitude, divided by d to normalize the direction
+                float magnitude = s * (square / std::max(d2, 1e-4f) + (1.0f - square)) / d * inside;
+                ax[i] += dx * magnitude; ay[i] += dy * magnitude; az[i] += dz * magnitude;
+            }
+            break;
+        }
+        case VORTEX: {
+            const glm::vec3 a = glm::normalize(axis);
+            const float px = position.x, py = position.y, pz = position.z;
+            const float s = strength;
+            #pragma omp simd
+            for (int i = 0; i < n; i++) {
+                float rx = x[i] - px, ry = y[i] - py, rz = z[i] - pz;
+                float along = rx * a.x + ry * a.y + rz * a.z;
+                rx -= along * a.x; ry -= along * a.y; rz -= along * a.z; // radial part
+                float d2 = rx * rx + ry * ry + rz * rz;
+                float inside = static_cast<float>(d2 < radius2) * static_cast<float>(x[i] >= rmin.x && x[i] <= rmax.x && y[i] >= rmin.y && y[i] <= rmax.y && z[i] >= rmin.z && z[i] <= rmax.z);
+                float magnitude = s / std::sqrt(std::max(d2, 1e-8f)) * inside;
+                // tangent = axis x radial
+                ax[i] += (a.y * rz - a.z * ry) * magnitude;
+                ay[i] += (a.z * rx - a.x * rz) * magnitude;
+                az[i] += (a.x * ry - a.y * rx) * magnitude;
+            }
+            break;
+        }
+        case WIND: {
+            const float wx = vector.x, wy = vector.y, wz = vector.z;
+            #pragma omp simd
+            for (int i = 0; i < n; i++) {
+                float inside = static_cast<float>(x[i] >= rmin.x && x[i] <= rmax.x && y[i] >= rmin.y && y[i] <= rmax.y && z[i] >= rmin.z && z[i] <= rmax.z);
+                ax[i] += wx * inside; ay[i] += wy * inside; az[i] += wz * inside;
+            }
+            break;
+        }
+        case DRAG: {
+            const float mx = vector.x, my = vector.y, mz = vector.z;
+            const float k = strength;
+            #pragma omp simd
+            for (int i = 0; i < n; i++) {
+                float inside = k * static_cast<float>(x[i] >= rmin.x && x[i] <= rmax.x && y[i] >= rmin.y && y[i] <= rmax.y && z[i] >= rmin.z && z[i] <= rmax.z);
+                ax[i] += (mx - vx[i]) * inside; ay[i] += (my - vy[i]) * inside; az[i] += (mz - vz[i]) * inside;
+            }
+            break;
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// positions, velocities and accelerations of the spheres of a grid cell, in structure of arrays so the fields are evaluated with SIMD
+struct FieldBatch {
+    std::vector<float> x, y, z;
+    std::vector<float> vx, vy, vz;
+    std::vector<float> ax, ay, az;
+
+    void resize(int n);
+};
+
+// Declarative acceleration field applied to the particles at every substep (read from the world file)
+class ForceField {
+
+    public:
+        enum Type {
+            ATTRACTOR, // towards a point (away from it with a negative strength)
+            VORTEX, // around an axis going through a point
+            WIND, // uniform acceleration
+            DRAG // linear drag relative to the velocity of the medium
+        };
+
+        Type type;
+        bool enabled = true;
+        glm::vec3 position = glm::vec3(0.0f); // ATTRACTOR and VORTEX
+        glm::vec3 axis = glm::vec3(0.0f, 1.0f, 0.0f); // VORTEX
+        glm::vec3 vector = glm::vec3(0.0f); // WIND acceleration, DRAG velocity of the medium
+        float strength = 1.0f; // ATTRACTOR and VORTEX acceleration, DRAG coefficient
+        bool inverseSquare = false; // ATTRACTOR, the acceleration is strength / distance^2 instead of constant
+        float radius = 0.0f; // ATTRACTOR and VORTEX, the field only acts closer than this (0 : everywhere)
+        bool hasRegion = false; // the field only acts inside the box [regionMin, regionMax]
+        glm::vec3 regionMin;
+        glm::vec3 regionMax;
+
+        ForceField(Type type);
+        bool isBounded() const;
+        void getBounds(glm::vec3& min, glm::vec3& max) const; // box outside of which the field is null (only for bounded fields)
+        void apply(FieldBatch& batch, int n) const; // add the acceleration of the field to the n first spheres of the batch
+};
@@ -0,0 +1,156 @@
+#include "frameRecorder.hpp"
+#include "../utils/image_writer.hpp"
+#include <glew.h>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <filesystem>
+
+FrameRecorder::FrameRecorder(int width, int height, const std::string& directory, const std::string& format, int stride, int numWriters)
+    : width(width), height(height), directory(directory), format(format), stride(stride) {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Failed to create the output directory " << directory << ": " << error.message() << std::endl;
+    }
+
+    // offscreen framebuffer: color and depth render buffers of the requested size
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Offscreen framebuffer is not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &fbo);
+        fbo = 0;
+        return;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenBuffers(2, pbos);
+    for (int i = 0; i < 2; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<size_t>(width) * height * 4, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    for (int i = 0; i < numWriters; i++) {
+        writers.emplace_back(&FrameRecorder::writerLoop, this);
+    }
+}
+
+FrameRecorder::~FrameRecorder() {
+    finish();
+    if (fbo != 0) {
+        glDeleteBuffers(2, pbos);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+        glDeleteFramebuffers(1, &fbo);
+    }
+}
+
+void FrameRecorder::bind() {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width, height);
+}
+
+void FrameRecorder::capture() {
+    if (fbo == 0) {
+        return;
+    }
+    if (frame++ % stride != 0) {
+        return;
+    }
+
+    // asynchronous read back of this frame into one pixel buffer
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[pboIndex]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    pboImage[pboIndex] = imageIndex++;
+
+    // the other one holds the previous capture, its transfer had a whole frame to complete
+    pboIndex = 1 - pboIndex;
+    if (pboImage[pboIndex] >= 0) {
+        collect(pboIndex);
+    }
+}
+
+void FrameRecorder::collect(int pbo) {
+    Frame image;
+    image.index = pboImage[pbo];
+    image.pixels.resize(static_cast<size_t>(width) * height * 4);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[pbo]);
+    const void* data = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    if (data != nullptr) {
+        std::memcpy(image.pixels.data(), data, image.pixels.size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    pboImage[pbo] = -1;
+    if (data == nullptr) {
+        std::cerr << "Failed to map the pixels of frame " << image.index << std::endl;
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    // ! only waits when the disk can't keep up, so that the memory stays bounded
+    queueChanged.wait(lock, [this] { return queue.size() < RECORDER_MAX_QUEUED; });
+    queue.push_back(std::move(image));
+    queueChanged.notify_all();
+}
+
+void FrameRecorder::finish() {
+    if (fbo != 0 && pboImage[1 - pboIndex] >= 0) {
+        collect(1 - pboIndex); // last capture
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    queueChanged.notify_all();
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    writers.clear();
+}
+
+void FrameRecorder::writerLoop() {
+    while (true) {
+        Frame image;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            queueChanged.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return; // stopping and nothing left to write
+            }
+            image = std::move(queue.front());
+            queue.pop_front();
+        }
+        queueChanged.notify_all();
+
+        std::ostringstream path;
+        path << directory << "/frame_" << std::setw(6) << std::setfill('0') << image.index << "." << format;
+        bool ok = format == "ppm" ? writePPM(path.str(), image.pixels.data(), width, height) : writePNG(path.str(), image.pixels.data(), width, height);
+        if (!ok) {
+            std::cerr << "Failed to write " << path.str() << std::endl;
+        } else {
+            written++;
+        }
+    }
+}
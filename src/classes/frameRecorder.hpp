@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glew.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#define RECORDER_MAX_QUEUED 16 // frames waiting for the writers before the capture waits for them
+
+// * renders into an offscreen framebuffer and writes every stride-th frame as an image
+// the pixels are read back through two pixel buffers (a frame is read while the previous one is transferred)
+// and encoded by a pool of writer threads, so the simulation doesn't wait for the GPU nor the disk
+class FrameRecorder {
+public:
+    FrameRecorder(int width, int height, const std::string& directory, const std::string& format = "png", int stride = 1, int numWriters = 2);
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    bool isComplete() const { return fbo != 0; } // false if the framebuffer could not be created
+    void bind(); // the next draws go to the offscreen framebuffer
+    void capture(); // to call once the frame is drawn
+    void finish(); // write the frames still read back and wait for the writers
+    int getWrittenFrames() const { return written; }
+
+private:
+    struct Frame {
+        int index;
+        std::vector<unsigned char> pixels; // RGBA, rows from the bottom
+    };
+
+    int width, height;
+    std::string directory;
+    std::string format;
+    int stride;
+    int frame = 0; // rendered frames
+    int imageIndex = 0; // captured frames
+
+    GLuint fbo = 0, colorBuffer = 0, depthBuffer = 0;
+    GLuint pbos[2] = {0, 0};
+    int pboImage[2] = {-1, -1}; // image read back in each pixel buffer, -1 if none
+    int pboIndex = 0; // pixel buffer of the next read back
+
+    std::vector<std::thread> writers;
+    std::deque<Frame> queue;
+    std::mutex mutex;
+    std::condition_variable queueChanged;
+    bool stopping = false;
+    std::atomic<int> written{0};
+
+    void collect(int pbo); // copy a finished read back to the queue of the writers
+    void writerLoop();
+};
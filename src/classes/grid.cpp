@@ -1,30 +1,47 @@
 #include "grid.hpp"
 #include "simulation.hpp"
 #include "particle.hpp"
+#include "container.hpp"
 #include <glm/glm.hpp>
 #include <vector>
 #include <memory>
 #include <iostream>
 #include <map>
+#include <limits>
+#include <algorithm>
 #include <unordered_map>
 
 
 
 Grid::Grid(float cellSize) {
     this->cellSize = cellSize;
+    clear();
 }
 
-glm::ivec3 Grid::getCell(glm::vec3 position) {
-    return glm::ivec3(position / cellSize); // converting to the largest integer less than or equal to the value
+float Grid::getCellSize() const {
+    return cellSize;
+}
+
+glm::ivec3 Grid::getCell(glm::vec3 position) const {
+    return glm::ivec3(glm::floor(position / cellSize)); // converting to the largest integer less than or equal to the value
+}
+
+void Grid::getCellBounds(glm::ivec3 cell, glm::vec3& min, glm::vec3& max) const {
+    min = glm::vec3(cell) * cellSize;
+    max = min + glm::vec3(cellSize);
 }
 
 void Grid::insert(std::shared_ptr<Sphere> sphere) {
     glm::ivec3 cell = getCell(sphere->position);
     grid[cell].push_back(sphere);
+    occupiedMin = glm::min(occupiedMin, cell);
+    occupiedMax = glm::max(occupiedMax, cell);
 }
 
 void Grid::clear() {
     grid.clear();
+    occupiedMin = glm::ivec3(std::numeric_limits<int>::max());
+    occupiedMax = glm::ivec3(std::numeric_limits<int>::min());
 }
 
 std::vector<std::shared_ptr<Sphere>> Grid::getNeighbors(std::shared_ptr<Sphere> sphere) {
@@ -51,6 +68,119 @@ std::vector<std::shared_ptr<Sphere>> Grid::getNeighbors(std::shared_ptr<Sphere>
     return neighbors;
 }
 
+const std::vector<std::shared_ptr<Sphere>>* Grid::getCellContent(glm::ivec3 cell) const {
+    auto it = grid.find(cell);
+    return it != grid.end() ? &it->second : nullptr;
+}
+
+RayHit Grid::raycast(const Ray& ray, float maxDistance) const {
+    RayHit hit;
+    hit.distance = std::numeric_limits<float>::max();
+    if (grid.empty()) {
+        return hit;
+    }
+    glm::vec3 direction = glm::normalize(ray.direction);
+    Ray unitRay(ray.origin, direction); // distances in world units
+
+    // * clipping the ray to the occupied cells, with one cell of margin since the spheres stick out of their cell
+    glm::ivec3 firstCell = occupiedMin - glm::ivec3(1);
+    glm::ivec3 lastCell = occupiedMax + glm::ivec3(1);
+    glm::vec3 boxMin = glm::vec3(firstCell) * cellSize;
+    glm::vec3 boxMax = glm::vec3(lastCell + glm::ivec3(1)) * cellSize;
+    float tStart = 0.0f;
+    float tEnd = maxDistance;
+    for (int a = 0; a < 3; a++) {
+        if (direction[a] == 0.0f) {
+            if (ray.origin[a] < boxMin[a] || ray.origin[a] > boxMax[a]) {
+                return hit;
+            }
+            continue;
+        }
+        float t0 = (boxMin[a] - ray.origin[a]) / direction[a];
+        float t1 = (boxMax[a] - ray.origin[a]) / direction[a];
+        tStart = std::max(tStart, std::min(t0, t1));
+        tEnd = std::min(tEnd, std::max(t0, t1));
+    }
+    if (tStart > tEnd) {
+        return hit;
+    }
+    hit.distance = maxDistance;
+
+    // * 3D DDA (Amanatides & Woo): the cells crossed by the ray, in order, from where it enters the occupied cells
+    glm::ivec3 cell = glm::clamp(getCell(ray.origin + direction * tStart), firstCell, lastCell);
+    glm::ivec3 step;
+    glm::vec3 tMax, tDelta; // distance to the next boundary on each axis, distance between two boundaries
+    for (int a = 0; a < 3; a++) {
+        if (direction[a] > 0.0f) {
+            step[a] = 1;
+            tMax[a] = ((cell[a] + 1) * cellSize - ray.origin[a]) / direction[a];
+            tDelta[a] = cellSize / direction[a];
+        } else if (direction[a] < 0.0f) {
+            step[a] = -1;
+            tMax[a] = (cell[a] * cellSize - ray.origin[a]) / direction[a];
+            tDelta[a] = -cellSize / direction[a];
+        } else {
+            step[a] = 0;
+            tMax[a] = std::numeric_limits<float>::max();
+            tDelta[a] = std::numeric_limits<float>::max();
+        }
+    }
+
+    auto testCell = [&](glm::ivec3 neighbor) {
+        const std::vector<std::shared_ptr<Sphere>>* content = getCellContent(neighbor);
+        if (content == nullptr) {
+            return;
+        }
+        for (const auto& sphere : *content) {
+            if (sphere->removed) {
+                continue;
+            }
+            float distance = unitRay.intersect(*sphere);
+            if (distance >= 0.0f && distance < hit.distance) {
+                hit.sphere = sphere;
+                hit.distance = distance;
+            }
+        }
+    };
+
+    // a sphere hit inside a cell has its center in a neighboring cell (the radius is at most half a cell)
+    for (int x = -1; x <= 1; ++x) {
+        for (int y = -1; y <= 1; ++y) {
+            for (int z = -1; z <= 1; ++z) {
+                testCell(cell + glm::ivec3(x, y, z));
+            }
+        }
+    }
+
+    while (true) {
+        // the next cells can only hold hits farther than the exit of this one
+        int axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+        if (tMax[axis] > tEnd || (hit.sphere && hit.distance <= tMax[axis])) {
+            break;
+        }
+        cell[axis] += step[axis];
+        tMax[axis] += tDelta[axis];
+
+        // the neighbors of the previous cell were already tested, only the slab on the far side is new
+        int u = (axis + 1) % 3;
+        int v = (axis + 2) % 3;
+        glm::ivec3 neighbor = cell;
+        neighbor[axis] += step[axis];
+        for (int du = -1; du <= 1; ++du) {
+            for (int dv = -1; dv <= 1; ++dv) {
+                neighbor[u] = cell[u] + du;
+                neighbor[v] = cell[v] + dv;
+                testCell(neighbor);
+            }
+        }
+    }
+
+    if (!hit.sphere) {
+        hit.distance = std::numeric_limits<float>::max();
+    }
+    return hit;
+}
+
 std::vector<std::shared_ptr<Sphere>> Grid::getNeighbors(glm::ivec3 cell) {
     std::vector<std::shared_ptr<Sphere>> neighbors;
     for (int x = -1; x <= 1; ++x) {
@@ -70,4 +200,42 @@ std::vector<std::shared_ptr<Sphere>> Grid::getNeighbors(glm::ivec3 cell) {
         }
     }
     return neighbors;
+}
+
+bool ContainerRaster::isNearBoundary(glm::ivec3 cell) const {
+    glm::ivec3 local = cell - origin;
+    if (local.x < 0 || local.y < 0 || local.z < 0 || local.x >= dims.x || local.y >= dims.y || local.z >= dims.z) {
+        return forcedInside;
+    }
+    return nearBoundary[(local.z * dims.y + local.y) * dims.x + local.x] != 0;
+}
+
+const ContainerRaster& Grid::getContainerRaster(Container& container) {
+    auto it = containerRasters.find(&container);
+    if (it != containerRasters.end() && it->second.version == container.getVersion()) {
+        return it->second;
+    }
+
+    // the margin is a whole cell so any sphere of the cell (radius up to half a cell) is covered
+    glm::vec3 min, max;
+    container.getBounds(min, max);
+    ContainerRaster& raster = containerRasters[&container];
+    raster.origin = getCell(min - glm::vec3(cellSize));
+    raster.dims = getCell(max + glm::vec3(cellSize)) - raster.origin + glm::ivec3(1);
+    raster.nearBoundary.assign(static_cast<size_t>(raster.dims.x) * raster.dims.y * raster.dims.z, 0);
+    raster.forcedInside = container.getForcedInside();
+    raster.version = container.getVersion();
+
+    #pragma omp parallel for schedule(static)
+    for (int z = 0; z < raster.dims.z; ++z) {
+        for (int y = 0; y < raster.dims.y; ++y) {
+            for (int x = 0; x < raster.dims.x; ++x) {
+                glm::vec3 cellMin, cellMax;
+                getCellBounds(raster.origin + glm::ivec3(x, y, z), cellMin, cellMax);
+                raster.nearBoundary[(z * raster.dims.y + y) * raster.dims.x + x] = container.isNearBoundary(cellMin, cellMax, cellSize) ? 1 : 0;
+            }
+        }
+    }
+
+    return raster;
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "particle.hpp"
+#include "../utils/ray.hpp"
 #include <glm/glm.hpp>
 #include <vector>
 #include <memory>
@@ -19,18 +20,35 @@ struct IVec3Hash { // using a FNV-1a hash function
 };
 
 
+struct ContainerRaster { // cells of the grid where a sphere can touch the walls of a container
+    glm::ivec3 origin; // first cell of the rasterized region
+    glm::ivec3 dims; // number of cells of the region along each axis
+    std::vector<unsigned char> nearBoundary; // one flag per cell of the region
+    bool forcedInside; // cells outside the region are only tested for containers that force the spheres inside
+    unsigned int version; // version of the container when it was rasterized
+
+    bool isNearBoundary(glm::ivec3 cell) const;
+};
+
 class Grid {
 
 private:
     float cellSize;
+    glm::ivec3 occupiedMin, occupiedMax; // bounds of the non-empty cells, for clipping the rays
 
 public:
     std::unordered_map<glm::ivec3, std::vector<std::shared_ptr<Sphere>>, IVec3Hash> grid;
+    std::unordered_map<const Container*, ContainerRaster> containerRasters;
 
     Grid(float cellSize);
-    glm::ivec3 getCell(glm::vec3 position);
+    float getCellSize() const;
+    glm::ivec3 getCell(glm::vec3 position) const;
+    void getCellBounds(glm::ivec3 cell, glm::vec3& min, glm::vec3& max) const;
     void insert(std::shared_ptr<Sphere> sphere);
     void clear();
     std::vector<std::shared_ptr<Sphere>> getNeighbors(std::shared_ptr<Sphere> sphere);
     std::vector<std::shared_ptr<Sphere>> getNeighbors(glm::ivec3 cell);
+    const std::vector<std::shared_ptr<Sphere>>* getCellContent(glm::ivec3 cell) const; // null for an empty cell, no copy and safe to call from several threads
+    RayHit raycast(const Ray& ray, float maxDistance) const; // first sphere hit, walking the cells along the ray (3D DDA) inside the occupied cells, safe to call from several threads
+    const ContainerRaster& getContainerRaster(Container& container); // rasterize the container the first time and whenever it changes
 };
\ No newline at end of file
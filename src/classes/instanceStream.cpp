@@ -0,0 +1,139 @@
+#include "instanceStream.hpp"
+#include <glew.h>
+#include <algorithm>
+#include <iostream>
+
+#define INITIAL_STREAM_CAPACITY 1024
+#define FENCE_TIMEOUT 1000000000 // 1 s in nanoseconds
+
+InstanceStream::InstanceStream(bool halfPrecision, int elements) : halfPrecision(halfPrecision), elements(elements) {
+    persistent = GLEW_ARB_buffer_storage || GLEW_VERSION_4_4;
+    if (!persistent) {
+        std::cerr << "Warning: GL_ARB_buffer_storage not supported, the instances are uploaded with glBufferSubData" << std::endl;
+    }
+}
+
+InstanceStream::~InstanceStream() {
+    release();
+}
+
+void InstanceStream::setHalfPrecision(bool halfPrecision) {
+    if (this->halfPrecision == halfPrecision) {
+        return;
+    }
+    // the stride changes, the buffer is allocated again at the next frame
+    release();
+    this->halfPrecision = halfPrecision;
+}
+
+void InstanceStream::release() {
+    for (int i = 0; i < INSTANCE_STREAM_REGIONS; i++) {
+        waitFence(i);
+    }
+    if (buffer != 0) {
+        if (mapped != nullptr) {
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            mapped = nullptr;
+        }
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+    capacity = 0;
+    region = 0;
+}
+
+void InstanceStream::waitFence(int region) {
+    if (fences[region] == nullptr) {
+        return;
+    }
+    // the fence is flushed at the first try only, then we just wait for the GPU
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (true) {
+        GLenum status = glClientWaitSync(fences[region], flags, FENCE_TIMEOUT);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED || status == GL_WAIT_FAILED) {
+            break;
+        }
+        flags = 0;
+    }
+    glDeleteSync(fences[region]);
+    fences[region] = nullptr;
+}
+
+void InstanceStream::allocate(size_t count) {
+    // * geometric growth, a growing scene reallocates O(log n) times
+    size_t newCapacity = std::max(count, std::max<size_t>(INITIAL_STREAM_CAPACITY, capacity * 2));
+    release();
+    capacity = newCapacity;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (persistent) {
+        // ! immutable storage: growing needs a new buffer, the attribute is pointed to it again at every draw
+        GLsizeiptr size = INSTANCE_STREAM_REGIONS * capacity * getStride();
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+        mapped = static_cast<char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+        if (mapped == nullptr) {
+            std::cerr << "Warning: failed to map the instance buffer, using glBufferSubData" << std::endl;
+            persistent = false;
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glDeleteBuffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        }
+    }
+    if (!persistent) {
+        glBufferData(GL_ARRAY_BUFFER, capacity * getStride(), NULL, GL_STREAM_DRAW);
+        staging.resize(capacity * getStride());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void* InstanceStream::begin(size_t count) {
+    this->count = count;
+    if (buffer == 0 || count > capacity) {
+        allocate(count);
+    }
+
+    if (!persistent) {
+        return staging.data();
+    }
+
+    // the GPU may still read this region from INSTANCE_STREAM_REGIONS frames ago
+    waitFence(region);
+    return mapped + region * capacity * getStride();
+}
+
+void InstanceStream::end() {
+    if (persistent || count == 0) {
+        return; // coherent mapping, nothing to flush
+    }
+    // orphan the previous storage so that the upload doesn't wait for the last draw
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, capacity * getStride(), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * getStride(), staging.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceStream::bindAttribute(GLuint attributeIndex, GLuint divisor, size_t first, int element) const {
+    size_t offset = ((persistent ? region * capacity : 0) + first) * getStride() + element * getElementSize();
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glEnableVertexAttribArray(attributeIndex);
+    if (halfPrecision) {
+        glVertexAttribPointer(attributeIndex, 4, GL_HALF_FLOAT, GL_FALSE, getStride(), (void*)offset);
+    } else {
+        glVertexAttribPointer(attributeIndex, 4, GL_FLOAT, GL_FALSE, getStride(), (void*)offset);
+    }
+    glVertexAttribDivisor(attributeIndex, divisor);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceStream::fence() {
+    if (!persistent) {
+        return;
+    }
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region = (region + 1) % INSTANCE_STREAM_REGIONS;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glew.h>
+#include <vector>
+#include <cstddef>
+#include <cstring>
+
+#define INSTANCE_STREAM_REGIONS 3 // triple buffering: the CPU writes one region while the GPU reads the others
+
+// * per instance data streamed to the GPU every frame: interleaved vec4s per instance (position and radius for the spheres, two ends for the links)
+// when the driver supports GL_ARB_buffer_storage, the buffer is persistently mapped and split in regions guarded by fences
+// otherwise the data is written in a staging array and uploaded with glBufferSubData into an orphaned buffer
+class InstanceStream {
+public:
+    InstanceStream(bool halfPrecision = false, int elements = 1); // elements: number of vec4 per instance
+    ~InstanceStream();
+
+    InstanceStream(const InstanceStream&) = delete;
+    InstanceStream& operator=(const InstanceStream&) = delete;
+
+    // returns where to write count instances (grows the buffer if needed), waits for the GPU to release the region
+    void* begin(size_t count);
+    // makes the written instances visible to the GPU
+    void end();
+    // points the vertex attribute of the bound VAO to the element of instance first of the current region (divisor 1 for instancing, 0 for points)
+    void bindAttribute(GLuint attributeIndex, GLuint divisor = 1, size_t first = 0, int element = 0) const;
+    // to call after the draw call reading the current region, moves to the next region
+    void fence();
+
+    // writes an element of instance i in a region returned by begin (packed to half floats in half precision)
+    void write(void* data, size_t i, const glm::vec3& position, float radius, int element = 0) const;
+
+    void setHalfPrecision(bool halfPrecision);
+    bool isHalfPrecision() const { return halfPrecision; }
+    bool isPersistent() const { return persistent; }
+    int getElements() const { return elements; }
+    size_t getElementSize() const { return halfPrecision ? 4 * sizeof(GLushort) : 4 * sizeof(GLfloat); }
+    size_t getStride() const { return elements * getElementSize(); }
+
+private:
+    GLuint buffer = 0;
+    bool halfPrecision;
+    int elements;
+    bool persistent;
+    size_t capacity = 0; // instances per region
+    int region = 0;
+    char* mapped = nullptr;
+    GLsync fences[INSTANCE_STREAM_REGIONS] = {};
+    std::vector<char> staging; // fallback without persistent mapping
+    size_t count = 0;
+
+    void allocate(size_t count);
+    void release();
+    void waitFence(int region);
+};
+
+inline void InstanceStream::write(void* data, size_t i, const glm::vec3& position, float radius, int element) const {
+    char* destination = static_cast<char*>(data) + i * getStride() + element * getElementSize();
+    if (halfPrecision) {
+        glm::uint64 packed = glm::packHalf4x16(glm::vec4(position, radius));
+        std::memcpy(destination, &packed, sizeof(packed));
+    } else {
+        glm::vec4 value(position, radius);
+        std::memcpy(destination, &value, sizeof(value));
+    }
+}
@@ -0,0 +1,58 @@
+#include "kinematicMotion.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+#include <cmath>
+
+glm::mat3 KinematicMotion::axisAngle(glm::vec3 axis, float degrees) {
+    // Rodrigues' rotation formula, written column by column
+    glm::vec3 a = glm::normalize(axis);
+    float angle = glm::radians(degrees);
+    float c = std::cos(angle), s = std::sin(angle), t = 1.0f - c;
+    return glm::mat3(
+        glm::vec3(t * a.x * a.x + c, t * a.x * a.y + s * a.z, t * a.x * a.z - s * a.y),
+        glm::vec3(t * a.x * a.y - s * a.z, t * a.y * a.y + c, t * a.y * a.z + s * a.x),
+        glm::vec3(t * a.x * a.z + s * a.y, t * a.y * a.z - s * a.x, t * a.z * a.z + c)
+    );
+}
+
+void KinematicMotion::evaluate(float time, glm::vec3 initialPosition, glm::vec3& position, glm::mat3& orientation) const {
+    switch (type) {
+        case LINEAR:
+            position = initialPosition + velocity * time;
+            orientation = glm::mat3(1.0f);
+            break;
+        case ROTATION:
+            orientation = axisAngle(axis, angularSpeed * time);
+            position = pivot + orientation * (initialPosition - pivot);
+            break;
+        case KEYFRAMES: {
+            if (keyframes.empty()) {
+                position = initialPosition;
+                orientation = glm::mat3(1.0f);
+                break;
+            }
+            float start = keyframes.front().time;
+            float end = keyframes.back().time;
+            if (loop && end > start) {
+                time = start + std::fmod(time - start, end - start);
+            }
+            // find the keyframes around the time (there are usually only a few of them)
+            size_t next = 0;
+            while (next < keyframes.size() && keyframes[next].time <= time) {
+                next++;
+            }
+            if (next == 0 || next == keyframes.size()) {
+                const Keyframe& k = next == 0 ? keyframes.front() : keyframes.back();
+                position = k.position;
+                orientation = axisAngle(axis, k.angle);
+                break;
+            }
+            const Keyframe& k0 = keyframes[next - 1];
+            const Keyframe& k1 = keyframes[next];
+            float f = (time - k0.time) / (k1.time - k0.time);
+            position = glm::mix(k0.position, k1.position, f);
+            orientation = axisAngle(axis, glm::mix(k0.angle, k1.angle, f));
+            break;
+        }
+    }
+}
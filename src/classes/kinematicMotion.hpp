@@ -0,0 +1,34 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Scripted motion of a kinematic object (a container for now), evaluated from the simulation time
+class KinematicMotion {
+
+    public:
+        enum Type {
+            LINEAR, // constant velocity
+            ROTATION, // constant angular speed around an axis going through a pivot
+            KEYFRAMES // linear interpolation between keyframes
+        };
+
+        struct Keyframe {
+            float time;
+            glm::vec3 position;
+            float angle; // rotation around the axis of the motion, in degrees
+        };
+
+        Type type = LINEAR;
+        glm::vec3 velocity = glm::vec3(0.0f); // LINEAR
+        glm::vec3 axis = glm::vec3(0.0f, 1.0f, 0.0f); // ROTATION and KEYFRAMES
+        float angularSpeed = 0.0f; // ROTATION, in degrees per second
+        glm::vec3 pivot = glm::vec3(0.0f); // ROTATION, in world space
+        std::vector<Keyframe> keyframes; // KEYFRAMES, sorted by time
+        bool loop = false; // KEYFRAMES
+
+        // pose of the object at the given time, from its pose at time 0
+        void evaluate(float time, glm::vec3 initialPosition, glm::vec3& position, glm::mat3& orientation) const;
+
+        static glm::mat3 axisAngle(glm::vec3 axis, float degrees);
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+// Settings of the pairwise long range force between the particles (read from the world file)
+struct LongRangeForce {
+    enum Interaction {
+        GRAVITY, // attraction between the masses
+        COULOMB // between the charges, like charges repel
+    };
+
+    enum Method {
+        BARNES_HUT, // octree, accurate at any density
+        PARTICLE_MESH // FFT Poisson solve on a mesh over the containers, smooth fields of dense scenes
+    };
+
+    bool enabled = false;
+    Interaction interaction = GRAVITY;
+    Method method = BARNES_HUT;
+    float constant = 1.0f; // G or k
+    float softening = 0.05f; // added to the distances so close particles don't get infinite forces
+    float theta = 0.5f; // Barnes-Hut opening angle, a node is approximated when its size / distance is below it (0 is exact)
+    int resolution = 64; // number of mesh nodes along each axis for the particle mesh method (rounded up to a power of 2)
+};
@@ -3,15 +3,23 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glew.h>
 #include <vector>
+#include <algorithm>
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include "camera.hpp"
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
 #include "../config.hpp"
+#include "../utils/file_stamp.hpp"
+
+#define INITIAL_INSTANCE_CAPACITY 1024
+#define MESH_CACHE_EXTENSION ".mesh" // binary cache written next to the OBJ file
 
 Mesh::Mesh (const std::string& filename, bool instanced, bool single, bool oriented) {
-    loadFromFile(filename);
+    loadFromFile(filename, vertices, indices);
     setupMesh(instanced, single, oriented);
 }
 
@@ -27,12 +35,17 @@ void Mesh::createSubVBO(GLuint &VBO, GLuint attributeIndex, GLsizei size, GLint
 void Mesh::setupMesh(bool instanced, bool single, bool oriented) {
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
     glGenBuffers(1, &VBOPosition);
 
     glBindVertexArray(VAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+
+    // the element buffer binding is part of the VAO state
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
 
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
@@ -44,24 +57,16 @@ void Mesh::setupMesh(bool instanced, bool single, bool oriented) {
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
 
     if (instanced) {
-        if (!single) {
-            createSubVBO(VBOPosition, 3, MAX_PARTICLES * sizeof(glm::vec3), 3, sizeof(glm::vec3), NULL, (void*)0, 1);
-
-            createSubVBO(VBOscale, 4, MAX_PARTICLES * sizeof(glm::vec3), 3, sizeof(glm::vec3), NULL, (void*)0, 1);
-
-            if (oriented) {
-                createSubVBO(VBOrot, 5, MAX_PARTICLES * sizeof(glm::vec3), 3, sizeof(glm::vec3), NULL, (void*)0, 1);
-            }
+        // the instance VBOs start small and grow with the number of drawn instances
+        instanceCapacity = single ? 1 : INITIAL_INSTANCE_CAPACITY;
+        this->oriented = oriented;
 
-        } else { // case when we draw a single mesh
+        createSubVBO(VBOPosition, 3, instanceCapacity * sizeof(glm::vec3), 3, sizeof(glm::vec3), NULL, (void*)0, 1);
 
-            createSubVBO(VBOPosition, 3, sizeof(glm::vec3), 3, sizeof(glm::vec3), NULL, (void*)0, 1);
+        createSubVBO(VBOscale, 4, instanceCapacity * sizeof(glm::vec3), 3, sizeof(glm::vec3), NULL, (void*)0, 1);
 
-            createSubVBO(VBOscale, 4, sizeof(glm::vec3), 3, sizeof(glm::vec3), NULL, (void*)0, 1);
-
-            if (oriented) {
-                createSubVBO(VBOrot, 5, sizeof(glm::vec3), 3, sizeof(glm::vec3), NULL, (void*)0, 1);
-            }
+        if (oriented) {
+            createSubVBO(VBOrot, 5, instanceCapacity * sizeof(glm::vec4), 4, sizeof(glm::vec4), NULL, (void*)0, 1);
         }
     }
 
@@ -70,28 +75,70 @@ void Mesh::setupMesh(bool instanced, bool single, bool oriented) {
     glBindVertexArray(0);
 }
 
-void Mesh::draw(GLuint& ShaderProgram, const Camera& camera, std::vector<glm::vec3>& positions, std::vector<glm::vec3>& scales) {
-    glUseProgram(ShaderProgram);
+void Mesh::ensureInstanceCapacity(size_t count) {
+    if (count <= instanceCapacity) {
+        return;
+    }
+
+    // * double the capacity so that a growing scene only reallocates O(log n) times
+    instanceCapacity = std::max(count, instanceCapacity * 2);
+    GLsizeiptr size = instanceCapacity * sizeof(glm::vec3);
 
-    camera.loadMatricesIntoShader(ShaderProgram);
+    // re-specifying the data store keeps the buffer names, so the VAO bindings stay valid
+    glBindBuffer(GL_ARRAY_BUFFER, VBOPosition);
+    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, VBOscale);
+    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+    if (oriented) {
+        glBindBuffer(GL_ARRAY_BUFFER, VBOrot);
+        glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(glm::vec4), NULL, GL_STREAM_DRAW);
+    }
+}
+
+void Mesh::draw(GLuint& ShaderProgram, std::vector<glm::vec3>& positions, std::vector<glm::vec3>& scales) {
+    glUseProgram(ShaderProgram); // the camera matrices come from the uniform buffer
+
+    if (positions.empty()) {
+        return;
+    }
 
     glBindVertexArray(VAO);
+    ensureInstanceCapacity(positions.size());
     glBindBuffer(GL_ARRAY_BUFFER, VBOPosition);
     glBufferSubData(GL_ARRAY_BUFFER, 0, positions.size() * sizeof(glm::vec3), &positions[0]);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBOscale);
     glBufferSubData(GL_ARRAY_BUFFER, 0, scales.size() * sizeof(glm::vec3), &scales[0]);
 
-    glDrawArraysInstanced(GL_TRIANGLES, 0, vertices.size(), positions.size());
+    glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, (void*)0, positions.size());
     glBindVertexArray(0);
 }
 
-void Mesh::drawOriented(GLuint& ShaderProgram, const Camera &camera, std::vector<glm::vec3>& positions, std::vector<glm::vec3>& scales, std::vector<glm::vec3>& rotations) {
+void Mesh::drawStream(GLuint& ShaderProgram, const InstanceStream& stream, size_t count, size_t first) {
     glUseProgram(ShaderProgram);
 
-    camera.loadMatricesIntoShader(ShaderProgram);
+    if (count == 0) {
+        return;
+    }
 
     glBindVertexArray(VAO);
+    for (int element = 0; element < stream.getElements(); element++) {
+        stream.bindAttribute(3 + element, 1, first, element);
+    }
+
+    glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, (void*)0, count);
+    glBindVertexArray(0);
+}
+
+void Mesh::drawOriented(GLuint& ShaderProgram, std::vector<glm::vec3>& positions, std::vector<glm::vec3>& scales, std::vector<glm::vec4>& rotations) {
+    glUseProgram(ShaderProgram);
+
+    if (positions.empty()) {
+        return;
+    }
+
+    glBindVertexArray(VAO);
+    ensureInstanceCapacity(positions.size());
     glBindBuffer(GL_ARRAY_BUFFER, VBOPosition);
     glBufferSubData(GL_ARRAY_BUFFER, 0, positions.size() * sizeof(glm::vec3), &positions[0]);
 
@@ -99,59 +146,253 @@ void Mesh::drawOriented(GLuint& ShaderProgram, const Camera &camera, std::vector
     glBufferSubData(GL_ARRAY_BUFFER, 0, scales.size() * sizeof(glm::vec3), &scales[0]);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBOrot);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, rotations.size() * sizeof(glm::vec3), &rotations[0]);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, rotations.size() * sizeof(glm::vec4), &rotations[0]);
 
-    glDrawArraysInstanced(GL_TRIANGLES, 0, vertices.size(), positions.size());
+    glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, (void*)0, positions.size());
     glBindVertexArray(0);
 
 }
 
-void Mesh::loadFromFile(const std::string& filename) {
-    std::ifstream file(filename);
-    std::string line;
+void Mesh::loadFromFile(const std::string& filename, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    vertices.clear();
+    indices.clear();
+    if (loadCache(filename, vertices, indices)) {
+        return;
+    }
+    if (!parseObj(filename, vertices, indices)) {
+        std::cerr << "Unable to open file " << filename << std::endl;
+        return;
+    }
+    saveCache(filename, vertices, indices);
+}
+
+void Mesh::loadFromFile(const std::string& filename, std::vector<Vertex>& vertices) {
+    std::vector<Vertex> unique;
+    std::vector<unsigned int> indices;
+    loadFromFile(filename, unique, indices);
+
+    vertices.resize(indices.size());
+    for (size_t i = 0; i < indices.size(); i++) {
+        vertices[i] = unique[indices[i]];
+    }
+}
+
+// indices of a vertex of a face in the position, texture coordinate and normal lists (-1 when missing)
+struct ObjIndex {
+    int position, texCoord, normal;
+
+    bool operator==(const ObjIndex& other) const {
+        return position == other.position && texCoord == other.texCoord && normal == other.normal;
+    }
+};
+
+struct ObjIndexHash {
+    std::size_t operator()(const ObjIndex& index) const {
+        std::size_t h = 2166136261u;
+        h = (h ^ index.position) * 16777619u;
+        h = (h ^ index.texCoord) * 16777619u;
+        h = (h ^ index.normal) * 16777619u;
+        return h;
+    }
+};
+
+static void skipSpaces(const char*& c, const char* end) {
+    while (c < end && (*c == ' ' || *c == '\t' || *c == '\r')) {
+        c++;
+    }
+}
+
+static float parseFloat(const char*& c, const char* end) {
+    skipSpaces(c, end);
+    if (c >= end) {
+        return 0.0f; // missing component, strtof would read the next line
+    }
+    char* next;
+    float value = std::strtof(c, &next);
+    c = next > end ? end : next;
+    return value;
+}
+
+// OBJ index (1 based, negative from the end of the list) to a 0 based index, -1 if absent
+static int parseIndex(const char*& c, const char* end, size_t count) {
+    bool negative = c < end && *c == '-';
+    if (negative) {
+        c++;
+    }
+    if (c >= end || *c < '0' || *c > '9') {
+        return -1;
+    }
+    int value = 0;
+    while (c < end && *c >= '0' && *c <= '9') {
+        value = value * 10 + (*c++ - '0');
+    }
+    return negative ? static_cast<int>(count) - value : value - 1;
+}
+
+bool Mesh::parseObj(const std::string& filename, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    // * the whole file is read at once and tokenized in place, no string nor stream per line
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::string buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const char* c = buffer.data();
+    const char* end = c + buffer.size();
 
     std::vector<glm::vec3> positions;
     std::vector<glm::vec2> texCoords;
     std::vector<glm::vec3> normals;
+    std::unordered_map<ObjIndex, unsigned int, ObjIndexHash> uniqueVertices; // same position, texture coordinate and normal: same vertex
+    std::vector<unsigned int> face;
+
+    while (c < end) {
+        skipSpaces(c, end);
+        const char* lineEnd = static_cast<const char*>(std::memchr(c, '\n', end - c));
+        if (lineEnd == nullptr) {
+            lineEnd = end;
+        }
 
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string prefix;
-        iss >> prefix;
-
-        if (prefix == "v") {
+        if (c[0] == 'v' && c + 1 < lineEnd && (c[1] == ' ' || c[1] == '\t')) {
+            c += 1;
             glm::vec3 position;
-            iss >> position.x >> position.y >> position.z;
+            position.x = parseFloat(c, lineEnd);
+            position.y = parseFloat(c, lineEnd);
+            position.z = parseFloat(c, lineEnd);
             positions.push_back(position);
-        } else if (prefix == "vt") {
+        } else if (c[0] == 'v' && c + 2 < lineEnd && c[1] == 't') {
+            c += 2;
             glm::vec2 texCoord;
-            iss >> texCoord.x >> texCoord.y;
+            texCoord.x = parseFloat(c, lineEnd);
+            texCoord.y = parseFloat(c, lineEnd);
             texCoords.push_back(texCoord);
-        } else if (prefix == "vn") {
+        } else if (c[0] == 'v' && c + 2 < lineEnd && c[1] == 'n') {
+            c += 2;
             glm::vec3 normal;
-            iss >> normal.x >> normal.y >> normal.z;
+            normal.x = parseFloat(c, lineEnd);
+            normal.y = parseFloat(c, lineEnd);
+            normal.z = parseFloat(c, lineEnd);
             normals.push_back(normal);
-        } else if (prefix == "f") {
-            std::string vertexData[3];
-            iss >> vertexData[0] >> vertexData[1] >> vertexData[2];
-
-            for (const auto& data : vertexData) {
-                std::istringstream viss(data);
-                std::vector<int> indices(3);
-
-                for (int& index : indices) {
-                    viss >> index;
-                    if (viss.peek() == '/') {
-                        viss.ignore();
+        } else if (c[0] == 'f' && c + 1 < lineEnd) {
+            c += 1;
+            face.clear();
+            while (true) {
+                skipSpaces(c, lineEnd);
+                if (c >= lineEnd) {
+                    break;
+                }
+                // v, v/t, v//n or v/t/n
+                ObjIndex index = {parseIndex(c, lineEnd, positions.size()), -1, -1};
+                if (c < lineEnd && *c == '/') {
+                    c++;
+                    index.texCoord = parseIndex(c, lineEnd, texCoords.size());
+                    if (c < lineEnd && *c == '/') {
+                        c++;
+                        index.normal = parseIndex(c, lineEnd, normals.size());
                     }
                 }
+                while (c < lineEnd && *c != ' ' && *c != '\t' && *c != '\r') {
+                    c++; // ? unexpected characters, skipped up to the next vertex
+                }
+                if (index.position < 0 || index.position >= static_cast<int>(positions.size())) {
+                    continue;
+                }
+
+                auto inserted = uniqueVertices.emplace(index, static_cast<unsigned int>(vertices.size()));
+                if (inserted.second) {
+                    Vertex vertex;
+                    vertex.position = positions[index.position];
+                    vertex.texCoords = index.texCoord >= 0 && index.texCoord < static_cast<int>(texCoords.size()) ? texCoords[index.texCoord] : glm::vec2(0.0f);
+                    vertex.normal = index.normal >= 0 && index.normal < static_cast<int>(normals.size()) ? normals[index.normal] : glm::vec3(0.0f);
+                    vertices.push_back(vertex);
+                }
+                face.push_back(inserted.first->second);
+            }
 
-                Vertex vertex;
-                vertex.position = positions[indices[0] - 1];
-                vertex.texCoords = texCoords[indices[1] - 1];
-                vertex.normal = normals[indices[2] - 1];
-                vertices.push_back(vertex);
+            // polygons are split in a fan of triangles
+            for (size_t i = 2; i < face.size(); i++) {
+                indices.push_back(face[0]);
+                indices.push_back(face[i - 1]);
+                indices.push_back(face[i]);
             }
         }
+
+        c = lineEnd < end ? lineEnd + 1 : end;
+    }
+    return true;
+}
+
+// header of the mesh cache, the cache is rebuilt if the OBJ file changed since it was written
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t vertexSize; // sizeof(Vertex) of the build that wrote it
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t numVertices;
+    uint64_t numIndices;
+};
+
+bool Mesh::loadCache(const std::string& filename, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    std::ifstream file(filename + MESH_CACHE_EXTENSION, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    MeshCacheHeader header;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || !getSourceStamp(filename, sourceSize, sourceTime)) {
+        return false;
+    }
+    if (std::memcmp(header.magic, "MSH1", 4) != 0 || header.vertexSize != sizeof(Vertex)
+        || header.sourceSize != sourceSize || header.sourceTime != sourceTime) {
+        return false;
+    }
+
+    // a damaged file can still have the right stamp: the arrays must fill the rest of the file exactly
+    std::streamoff dataStart = file.tellg();
+    file.seekg(0, std::ios::end);
+    if (!file) {
+        return false;
     }
-}
\ No newline at end of file
+    uint64_t remaining = static_cast<uint64_t>(file.tellg() - dataStart);
+    if (header.numVertices > remaining / sizeof(Vertex) || header.numIndices > remaining / sizeof(unsigned int) || header.numIndices % 3 != 0
+        || header.numVertices * sizeof(Vertex) + header.numIndices * sizeof(unsigned int) != remaining) {
+        return false;
+    }
+    file.seekg(dataStart);
+
+    // two bulk reads straight into the arrays uploaded to the GPU
+    vertices.resize(header.numVertices);
+    indices.resize(header.numIndices);
+    bool valid = file.read(reinterpret_cast<char*>(vertices.data()), vertices.size() * sizeof(Vertex))
+        && file.read(reinterpret_cast<char*>(indices.data()), indices.size() * sizeof(unsigned int));
+    // the indices are used to read the vertices and drawn as is
+    for (size_t i = 0; valid && i < indices.size(); i++) {
+        valid = indices[i] < header.numVertices;
+    }
+    if (!valid) {
+        vertices.clear();
+        indices.clear();
+    }
+    return valid;
+}
+
+void Mesh::saveCache(const std::string& filename, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices) {
+    MeshCacheHeader header;
+    std::memcpy(header.magic, "MSH1", 4);
+    header.vertexSize = sizeof(Vertex);
+    header.numVertices = vertices.size();
+    header.numIndices = indices.size();
+    if (indices.empty() || !getSourceStamp(filename, header.sourceSize, header.sourceTime)) {
+        return;
+    }
+
+    std::string cachePath = filename + MESH_CACHE_EXTENSION;
+    bool written = writeCacheFile(cachePath, [&](std::ofstream& file) {
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(Vertex));
+        file.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(unsigned int));
+    });
+    if (!written) {
+        std::cerr << "Could not write the mesh cache: " << cachePath << std::endl;
+    }
+}
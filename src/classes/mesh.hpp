@@ -8,7 +8,7 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include "camera.hpp"
+#include "instanceStream.hpp"
 
 struct Vertex {
     glm::vec3 position;
@@ -18,17 +18,28 @@ struct Vertex {
 
 class Mesh {
 public:
-    GLuint VAO, VBO, VBOPosition, VBOscale, VBOrot;
-    std::vector<Vertex> vertices;
+    GLuint VAO, VBO, EBO, VBOPosition, VBOscale, VBOrot;
+    std::vector<Vertex> vertices; // unique vertices
+    std::vector<unsigned int> indices; // three per triangle
+    size_t instanceCapacity = 0; // number of instances the instance VBOs can hold
+    bool oriented = false;
 
     Mesh(const std::string &filename, bool instanced = false, bool single = false, bool oriented = false);
 
     void setupMesh(bool instanced = false, bool single = false, bool oriented = false);
 
-    void draw(GLuint& ShaderProgram, const Camera &camera, std::vector<glm::vec3>& positions, std::vector<glm::vec3>& scales);
-    void drawOriented(GLuint& ShaderProgram, const Camera &camera, std::vector<glm::vec3>& positions, std::vector<glm::vec3>& scales, std::vector<glm::vec3>& rotations);
+    void draw(GLuint& ShaderProgram, std::vector<glm::vec3>& positions, std::vector<glm::vec3>& scales);
+    void drawStream(GLuint& ShaderProgram, const InstanceStream& stream, size_t count, size_t first = 0); // instances first to first + count of the stream, read from attribute 3 (and the next ones for several elements)
+    void drawOriented(GLuint& ShaderProgram, std::vector<glm::vec3>& positions, std::vector<glm::vec3>& scales, std::vector<glm::vec4>& rotations); // rotations as unit quaternions (x, y, z, w), read from attribute 5
+
+    // indexed mesh of an OBJ file, read from the binary cache next to the file when it is up to date (does not need an OpenGL context)
+    static void loadFromFile(const std::string &filename, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+    static void loadFromFile(const std::string &filename, std::vector<Vertex>& vertices); // three vertices per triangle
 
 private:
-    void loadFromFile(const std::string &filename);
+    static bool parseObj(const std::string &filename, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+    static bool loadCache(const std::string &filename, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+    static void saveCache(const std::string &filename, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+    void ensureInstanceCapacity(size_t count); // grows the instance VBOs geometrically when needed
     void createSubVBO(GLuint &VBO, GLuint attributeIndex, GLsizei size, GLint numPerVertex, GLsizei stride, const void* pointer, const void* offset, GLuint divisor);
 };
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "meshCollider.hpp"
+#include "mesh.hpp"
+#include "bvh.hpp"
+#include "../utils/geometry.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+#include <string>
+#include <iostream>
+
+#define MESH_COLLIDER_ITERATIONS 4 // maximum number of contacts resolved per sphere and per step
+
+MeshCollider::MeshCollider(glm::vec3 position, const std::string& path, float scale) {
+    this->position = position;
+    this->path = path;
+    this->scale = scale;
+
+    std::vector<Vertex> meshVertices;
+    Mesh::loadFromFile(path, meshVertices);
+    if (meshVertices.size() < 3) {
+        std::cerr << "Mesh collider: no triangle found in " << path << std::endl;
+    }
+
+    const size_t num_triangles = meshVertices.size() / 3;
+    vertices.resize(num_triangles * 3);
+    normals.resize(num_triangles);
+    for (size_t i = 0; i < num_triangles * 3; ++i) {
+        vertices[i] = position + meshVertices[i].position * scale;
+    }
+    for (size_t t = 0; t < num_triangles; ++t) {
+        glm::vec3 n = glm::cross(vertices[3 * t + 1] - vertices[3 * t], vertices[3 * t + 2] - vertices[3 * t]);
+        float length = glm::length(n);
+        normals[t] = length > 0.0f ? n / length : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    bvh.build(vertices);
+}
+
+std::string MeshCollider::getPath() {
+    return path;
+}
+
+void MeshCollider::getBounds(glm::vec3& min, glm::vec3& max) {
+    if (bvh.nodes.empty()) {
+        min = max = position;
+        return;
+    }
+    min = bvh.nodes[0].min;
+    max = bvh.nodes[0].max;
+}
+
+const BVH& MeshCollider::getBVH() const {
+    return bvh;
+}
+
+const std::vector<glm::vec3>& MeshCollider::getVertices() const {
+    return vertices;
+}
+
+void MeshCollider::collideWith(const std::vector<std::shared_ptr<Sphere>>& spheres, glm::vec3 cellMin, glm::vec3 cellMax, std::vector<int>& triangles) const {
+    // the query box covers every sphere whose center is in the cell
+    float maxRadius = 0.0f;
+    for (auto& s : spheres) {
+        maxRadius = glm::max(maxRadius, s->radius);
+    }
+    bvh.query(cellMin - glm::vec3(maxRadius), cellMax + glm::vec3(maxRadius), triangles);
+    if (triangles.empty()) {
+        return;
+    }
+    for (auto& s : spheres) {
+        collideWith(s.get(), triangles);
+    }
+}
+
+void MeshCollider::collideWith(Sphere* sphere, const std::vector<int>& triangles) const {
+    if (sphere->getInverseMass() == 0.0f) {
+        return;
+    }
+
+    glm::vec3 unconstrainedPosition = sphere->position;
+    glm::vec3 totalNormal = glm::vec3(0.0f);
+    // resolve the deepest contact first, so the internal edges of a flat surface don't push the sphere sideways
+    for (int iteration = 0; iteration < MESH_COLLIDER_ITERATIONS; ++iteration) {
+        int closestTriangle = -1;
+        glm::vec3 closestAxis;
+        float closestDistance = sphere->radius;
+        for (int t : triangles) {
+            glm::vec3 axis = sphere->position - closestPointOnTriangle(sphere->position, vertices[3 * t], vertices[3 * t + 1], vertices[3 * t + 2]);
+            float distance = glm::length(axis);
+            if (distance < closestDistance) {
+                closestDistance = distance;
+                closestAxis = axis;
+                closestTriangle = t;
+            }
+        }
+        if (closestTriangle < 0) {
+            break;
+        }
+        // push the sphere out on the side it is, the face normal is only used if the center is on the surface
+        glm::vec3 normal = closestDistance > 1e-6f ? closestAxis / closestDistance : normals[closestTriangle];
+        sphere->position += normal * (sphere->radius - closestDistance);
+        totalNormal += normal;
+    }
+
+    if (totalNormal != glm::vec3(0.0f)) {
+        sphere->applyWallResponse(unconstrainedPosition, glm::normalize(totalNormal), restitution, friction);
+    }
+}
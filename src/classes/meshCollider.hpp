@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+#include <string>
+#include "particle.hpp"
+#include "bvh.hpp"
+
+// Static triangle mesh loaded from an OBJ file, the spheres collide with both sides of its surface
+class MeshCollider {
+
+    private:
+        std::string path;
+        std::vector<glm::vec3> vertices; // 3 vertices per triangle, in world space
+        std::vector<glm::vec3> normals; // one normal per triangle
+        BVH bvh;
+
+        void collideWith(Sphere* sphere, const std::vector<int>& triangles) const;
+
+    public:
+        glm::vec3 position;
+        float scale;
+        float restitution = 0.0f;
+        float friction = 0.0f;
+
+        MeshCollider(glm::vec3 position, const std::string& path, float scale = 1.0f);
+        std::string getPath();
+        void getBounds(glm::vec3& min, glm::vec3& max);
+        const BVH& getBVH() const;
+        const std::vector<glm::vec3>& getVertices() const;
+
+        // collide all the spheres of a grid cell, they share a single traversal of the BVH
+        void collideWith(const std::vector<std::shared_ptr<Sphere>>& spheres, glm::vec3 cellMin, glm::vec3 cellMax, std::vector<int>& triangles) const;
+};
@@ -3,6 +3,8 @@
 #include "particle.hpp"
 #include <vector>
 #include <memory>
+#include <algorithm>
+#include <unordered_map>
 
 Molecule::Molecule(float distance, bool linksEnabled, float strength, float internalPressure, bool useInternalPressure) {
     this->distance = distance;
@@ -13,11 +15,23 @@ Molecule::Molecule(float distance, bool linksEnabled, float strength, float inte
 }
 
 void Molecule::addSphere(std::shared_ptr<Sphere> sphere) {
+    sphere->skipLinkedCollisions = skipLinkedCollisions;
     spheres.push_back(sphere);
 }
 
 void Molecule::addLink(std::shared_ptr<Sphere> sphere1, std::shared_ptr<Sphere> sphere2) {
     links.push_back(std::make_pair(sphere1, sphere2));
+    linkColorsDirty = true;
+    // keep track of the link on both sides so the contact kernel can filter the pair
+    sphere1->linkedParticles.push_back(sphere2.get());
+    sphere2->linkedParticles.push_back(sphere1.get());
+}
+
+void Molecule::setSkipLinkedCollisions(bool skip) {
+    skipLinkedCollisions = skip;
+    for (auto& sphere : spheres) {
+        sphere->skipLinkedCollisions = skip;
+    }
 }
 
 void Molecule::maintainDistanceAll() {
@@ -35,6 +49,36 @@ void Molecule::maintainDistanceLinks() {
     }
 }
 
+const std::vector<std::vector<size_t>>& Molecule::getLinkColors() {
+    size_t colored = 0;
+    for (const auto& color : linkColors) {
+        colored += color.size();
+    }
+    if (!linkColorsDirty && colored == links.size()) {
+        return linkColors;
+    }
+
+    // * greedy coloring: each link takes the first color none of the links of its two spheres has
+    std::unordered_map<const Sphere*, std::vector<int>> sphereColors;
+    linkColors.clear();
+    for (size_t i = 0; i < links.size(); i++) {
+        std::vector<int>& colors1 = sphereColors[links[i].first.get()];
+        std::vector<int>& colors2 = sphereColors[links[i].second.get()];
+        int color = 0;
+        while (std::find(colors1.begin(), colors1.end(), color) != colors1.end() || std::find(colors2.begin(), colors2.end(), color) != colors2.end()) {
+            color++;
+        }
+        colors1.push_back(color);
+        colors2.push_back(color);
+        if (color >= static_cast<int>(linkColors.size())) {
+            linkColors.resize(color + 1);
+        }
+        linkColors[color].push_back(i);
+    }
+    linkColorsDirty = false;
+    return linkColors;
+}
+
 void Molecule::maintainDistance(std::shared_ptr<Sphere> sphere1, std::shared_ptr<Sphere> sphere2) {
 
     glm::vec3 axis = sphere1->position - sphere2->position; // vector between the two spheres
@@ -46,9 +90,17 @@ void Molecule::maintainDistance(std::shared_ptr<Sphere> sphere1, std::shared_ptr
     // Calculate the correction vector
     glm::vec3 correctionVector = axis * correctionDistance;
 
+    // Split the correction according to the inverse masses (unchanged for equal masses, and a sphere linked to a fixed one takes it all)
+    float inverseMassSum = sphere1->getInverseMass() + sphere2->getInverseMass();
+    if (inverseMassSum <= 0.0f) {
+        return;
+    }
+    float weight1 = 2.0f * sphere1->getInverseMass() / inverseMassSum;
+    float weight2 = 2.0f * sphere2->getInverseMass() / inverseMassSum;
+
     // Apply the correction
-    sphere1->move(-correctionVector);
-    sphere2->move(correctionVector);
+    sphere1->position -= correctionVector * weight1;
+    sphere2->position += correctionVector * weight2;
 
     // * see the attractive version bellow
     // glm::vec3 axis = sphere1->position - sphere2->position; // vector between the two spheres
@@ -85,3 +137,22 @@ void Molecule::addInternalPressure() {
         sphere->move(correctionVector);
     }
 }
+
+bool Molecule::removeMarkedSpheres() {
+    for (auto& link : links) {
+        // the surviving side of a broken link doesn't filter the removed sphere anymore
+        if (link.first->removed != link.second->removed) {
+            std::shared_ptr<Sphere> kept = link.first->removed ? link.second : link.first;
+            const Particle* gone = link.first->removed ? link.first.get() : link.second.get();
+            kept->linkedParticles.erase(std::remove(kept->linkedParticles.begin(), kept->linkedParticles.end(), gone), kept->linkedParticles.end());
+        }
+    }
+    linkColorsDirty = true;
+    links.erase(std::remove_if(links.begin(), links.end(), [](const std::pair<std::shared_ptr<Sphere>, std::shared_ptr<Sphere>>& link) {
+        return link.first->removed || link.second->removed;
+    }), links.end());
+    spheres.erase(std::remove_if(spheres.begin(), spheres.end(), [](const std::shared_ptr<Sphere>& sphere) {
+        return sphere->removed;
+    }), spheres.end());
+    return spheres.empty();
+}
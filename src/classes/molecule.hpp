@@ -10,20 +10,26 @@ class Molecule {
     private:
         float distance = 0.5f; // distance between the spheres centers
         float strength = 0.01f; // strength of the spring
+        std::vector<std::vector<size_t>> linkColors; // indices of the links by color, two links of a color share no sphere
+        bool linkColorsDirty = true;
 
     public:
 
         float internalPressure = 0.001f; // internal pressure of the molecule
         bool linksEnabled = false; // define if we should use the links to maintain the distance or not
         bool useInternalPressure = false; // define if we should use the internal pressure to maintain the distance or not
+        bool skipLinkedCollisions = false; // define if the linked spheres should ignore the contacts between them
         std::vector<std::shared_ptr<Sphere>> spheres;
         std::vector<std::pair<std::shared_ptr<Sphere>, std::shared_ptr<Sphere>>> links; // change this later to have multiple distances and strengths
         Molecule(float distance = 0.5f, bool linksEnabled = false, float strength = 0.01f, float internalPressure = 0.001f, bool useInternalPressure = false);
         void addSphere(std::shared_ptr<Sphere> sphere);
         void addLink(std::shared_ptr<Sphere> sphere1, std::shared_ptr<Sphere> sphere2);
+        void setSkipLinkedCollisions(bool skip);
         void maintainDistanceAll();
         void maintainDistanceLinks();
+        const std::vector<std::vector<size_t>>& getLinkColors(); // colored again when the links changed, the links of a color can be solved in parallel
         void maintainDistance(std::shared_ptr<Sphere> sphere1, std::shared_ptr<Sphere> sphere2);
         void addInternalPressure();
+        bool removeMarkedSpheres(); // forget the spheres removed from the simulation and their links, returns whether the molecule is now empty
         
 };
\ No newline at end of file
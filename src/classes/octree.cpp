@@ -0,0 +1,346 @@
+#include "octree.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+#include <omp.h>
+
+#define OCTREE_LEAF_SIZE 16 // maximum number of bodies in a leaf
+#define OCTREE_MAX_LEVEL 21 // 21 bits per axis in the 63 bits Morton codes
+#define OCTREE_PARALLEL_LEVEL 2 // the subtrees below this level are built in parallel (up to 64 of them)
+#define OCTREE_STACK_SIZE 256 // enough for OCTREE_MAX_LEVEL levels of 8 children
+
+// spread the 21 lowest bits of v so there are two zeros between each of them
+static uint64_t spreadBits(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffull;
+    v = (v | v << 16) & 0x1f0000ff0000ffull;
+    v = (v | v << 8) & 0x100f00f00f00f00full;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+    v = (v | v << 2) & 0x1249249249249249ull;
+    return v;
+}
+
+// sort the chunks of the threads in parallel, then merge them two by two
+static void parallelSort(std::vector<std::pair<uint64_t, int>>& items) {
+    int chunks = omp_get_max_threads();
+    if (chunks <= 1 || items.size() < 10000) {
+        std::sort(items.begin(), items.end());
+        return;
+    }
+    std::vector<size_t> bounds(chunks + 1);
+    for (int c = 0; c <= chunks; c++) {
+        bounds[c] = items.size() * c / chunks;
+    }
+    #pragma omp parallel for
+    for (int c = 0; c < chunks; c++) {
+        std::sort(items.begin() + bounds[c], items.begin() + bounds[c + 1]);
+    }
+    for (int width = 1; width < chunks; width *= 2) {
+        #pragma omp parallel for
+        for (int c = 0; c < chunks; c += 2 * width) {
+            int middle = std::min(c + width, chunks);
+            int end = std::min(c + 2 * width, chunks);
+            if (middle < end) {
+                std::inplace_merge(items.begin() + bounds[c], items.begin() + bounds[middle], items.begin() + bounds[end]);
+            }
+        }
+    }
+}
+
+static Octree::Node makeNode(glm::vec3 center, float halfSize, int first, int last) {
+    Octree::Node node;
+    node.center = center;
+    node.halfSize = halfSize;
+    node.sourceCenter = center;
+    node.strength = 0.0f;
+    node.absoluteStrength = 0.0f;
+    std::fill(node.children, node.children + 8, -1);
+    node.leaf = true;
+    node.first = first;
+    node.count = last - first;
+    return node;
+}
+
+// call f(octant, first, last, childCenter) for every non empty octant of the range
+// the codes of a node share the same prefix, so the octants are contiguous in the sorted range
+template <typename F>
+static void forEachOctant(const std::vector<uint64_t>& codes, int first, int last, int level, glm::vec3 center, float halfSize, F f) {
+    int shift = 3 * (OCTREE_MAX_LEVEL - 1 - level);
+    int start = first;
+    for (int octant = 0; octant < 8 && start < last; octant++) {
+        int end = static_cast<int>(std::partition_point(codes.begin() + start, codes.begin() + last, [&](uint64_t code) {
+            return static_cast<int>((code >> shift) & 7u) <= octant;
+        }) - codes.begin());
+        if (end > start) {
+            glm::vec3 offset = glm::vec3((octant & 1) ? 1.0f : -1.0f, (octant & 2) ? 1.0f : -1.0f, (octant & 4) ? 1.0f : -1.0f);
+            f(octant, start, end, center + offset * (halfSize / 2.0f));
+        }
+        start = end;
+    }
+}
+
+// total strength of the node and its center, from its bodies or its children
+static void computeSources(Octree::Node& node, const std::vector<Octree::Node>& nodes, const std::vector<glm::vec4>& sources) {
+    glm::vec3 weightedCenter = glm::vec3(0.0f);
+    float strength = 0.0f;
+    float absoluteStrength = 0.0f;
+    if (node.leaf) {
+        for (int i = node.first; i < node.first + node.count; i++) {
+            float w = std::abs(sources[i].w);
+            weightedCenter += glm::vec3(sources[i]) * w;
+            strength += sources[i].w;
+            absoluteStrength += w;
+        }
+    } else {
+        for (int c : node.children) {
+            if (c >= 0) {
+                weightedCenter += nodes[c].sourceCenter * nodes[c].absoluteStrength;
+                strength += nodes[c].strength;
+                absoluteStrength += nodes[c].absoluteStrength;
+            }
+        }
+    }
+    node.strength = strength;
+    node.absoluteStrength = absoluteStrength;
+    node.sourceCenter = absoluteStrength > 0.0f ? weightedCenter / absoluteStrength : node.center;
+}
+
+static int buildNode(std::vector<Octree::Node>& out, const std::vector<uint64_t>& codes, const std::vector<glm::vec4>& sources, int first, int last, int level, glm::vec3 center, float halfSize) {
+    int index = static_cast<int>(out.size());
+    out.push_back(makeNode(center, halfSize, first, last));
+    if (last - first > OCTREE_LEAF_SIZE && level < OCTREE_MAX_LEVEL) {
+        out[index].leaf = false;
+        forEachOctant(codes, first, last, level, center, halfSize, [&](int octant, int start, int end, glm::vec3 childCenter) {
+            int child = buildNode(out, codes, sources, start, end, level + 1, childCenter, halfSize / 2.0f);
+            out[index].children[octant] = child; // out may have grown, so no reference is kept
+        });
+    }
+    computeSources(out[index], out, sources);
+    return index;
+}
+
+struct SubtreeTask {
+    int parent;
+    int octant;
+    int first;
+    int last;
+    glm::vec3 center;
+    float halfSize;
+};
+
+// top of the tree, its nodes are split serially and the subtrees under them are queued
+static int buildTop(std::vector<Octree::Node>& out, std::vector<SubtreeTask>& tasks, const std::vector<uint64_t>& codes, int first, int last, int level, glm::vec3 center, float halfSize) {
+    int index = static_cast<int>(out.size());
+    out.push_back(makeNode(center, halfSize, first, last));
+    if (last - first > OCTREE_LEAF_SIZE) {
+        out[index].leaf = false;
+        forEachOctant(codes, first, last, level, center, halfSize, [&](int octant, int start, int end, glm::vec3 childCenter) {
+            if (level + 1 < OCTREE_PARALLEL_LEVEL) {
+                int child = buildTop(out, tasks, codes, start, end, level + 1, childCenter, halfSize / 2.0f);
+                out[index].children[octant] = child;
+            } else {
+                tasks.push_back({index, octant, start, end, childCenter, halfSize / 2.0f});
+            }
+        });
+    }
+    return index;
+}
+
+void Octree::build(const std::vector<std::shared_ptr<Particle>>& particles, LongRangeForce::Interaction interaction) {
+    const int n = static_cast<int>(particles.size());
+    nodes.clear();
+    bodies.resize(n);
+    sources.resize(n);
+    codes.resize(n);
+    if (n == 0) {
+        return;
+    }
+
+    // * bounding cube of the particles
+    float minX = particles[0]->position.x, minY = particles[0]->position.y, minZ = particles[0]->position.z;
+    float maxX = minX, maxY = minY, maxZ = minZ;
+    #pragma omp parallel for reduction(min: minX, minY, minZ) reduction(max: maxX, maxY, maxZ)
+    for (int i = 0; i < n; i++) {
+        glm::vec3 p = particles[i]->position;
+        minX = std::min(minX, p.x); minY = std::min(minY, p.y); minZ = std::min(minZ, p.z);
+        maxX = std::max(maxX, p.x); maxY = std::max(maxY, p.y); maxZ = std::max(maxZ, p.z);
+    }
+    glm::vec3 min = glm::vec3(minX, minY, minZ);
+    glm::vec3 max = glm::vec3(maxX, maxY, maxZ);
+    glm::vec3 center = (min + max) / 2.0f;
+    float halfSize = std::max(std::max(max.x - min.x, max.y - min.y), max.z - min.z) / 2.0f * 1.001f + 1e-4f;
+
+    // * sort the particles along the Morton curve
+    std::vector<std::pair<uint64_t, int>> order(n);
+    const float cells = static_cast<float>(1 << OCTREE_MAX_LEVEL);
+    glm::vec3 corner = center - glm::vec3(halfSize);
+    #pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        glm::vec3 q = glm::clamp((particles[i]->position - corner) / (2.0f * halfSize) * cells, glm::vec3(0.0f), glm::vec3(cells - 1.0f));
+        uint64_t code = spreadBits(static_cast<uint64_t>(q.x)) | (spreadBits(static_cast<uint64_t>(q.y)) << 1) | (spreadBits(static_cast<uint64_t>(q.z)) << 2);
+        order[i] = std::make_pair(code, i);
+    }
+    parallelSort(order);
+    #pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+        Particle* p = particles[order[i].second].get();
+        bodies[i] = p;
+        codes[i] = order[i].first;
+        sources[i] = glm::vec4(p->position, interaction == LongRangeForce::GRAVITY ? p->mass : p->charge);
+    }
+
+    // * build the tree, the subtrees below the top levels in parallel
+    std::vector<SubtreeTask> tasks;
+    buildTop(nodes, tasks, codes, 0, n, 0, center, halfSize);
+    const int topCount = static_cast<int>(nodes.size());
+    std::vector<std::vector<Node>> subtrees(tasks.size());
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int t = 0; t < static_cast<int>(tasks.size()); t++) {
+        buildNode(subtrees[t], codes, sources, tasks[t].first, tasks[t].last, OCTREE_PARALLEL_LEVEL, tasks[t].center, tasks[t].halfSize);
+    }
+    for (size_t t = 0; t < tasks.size(); t++) {
+        int offset = static_cast<int>(nodes.size());
+        for (Node node : subtrees[t]) {
+            for (int& c : node.children) {
+                if (c >= 0) {
+                    c += offset;
+                }
+            }
+            nodes.push_back(node);
+        }
+        nodes[tasks[t].parent].children[tasks[t].octant] = offset;
+    }
+    // the children of a top node come after it
+    for (int i = topCount - 1; i >= 0; i--) {
+        computeSources(nodes[i], nodes, sources);
+    }
+}
+
+glm::vec3 Octree::field(glm::vec3 point, float theta, float softening) const {
+    glm::vec3 result = glm::vec3(0.0f);
+    if (nodes.empty()) {
+        return result;
+    }
+    const float theta2 = theta * theta;
+    const float softening2 = softening * softening;
+
+    int stack[OCTREE_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (node.absoluteStrength == 0.0f) {
+            continue;
+        }
+        glm::vec3 d = node.sourceCenter - point;
+        float distance2 = glm::dot(d, d);
+        float size = 2.0f * node.halfSize;
+        if (size * size < theta2 * distance2) {
+            // far enough, the whole node acts as one source
+            float r2 = distance2 + softening2;
+            result += d * (node.strength / (r2 * std::sqrt(r2)));
+        } else if (node.leaf) {
+            // a body at the point itself (or coincident with it) adds nothing, even without softening
+            for (int i = node.first; i < node.first + node.count; i++) {
+                glm::vec3 dj = glm::vec3(sources[i]) - point;
+                float r2 = glm::dot(dj, dj) + softening2;
+                result += dj * (r2 > 0.0f ? sources[i].w / (r2 * std::sqrt(r2)) : 0.0f);
+            }
+        } else {
+            for (int c : node.children) {
+                if (c >= 0) {
+                    stack[top++] = c;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+void Octree::gatherInteractions(const Node& target, float theta, std::vector<glm::vec4>& interactions) const {
+    // same opening test as field() but against the whole box of the target leaf, so its bodies can share the list
+    const float theta2 = theta * theta;
+    glm::vec3 targetMin = target.center - glm::vec3(target.halfSize);
+    glm::vec3 targetMax = target.center + glm::vec3(target.halfSize);
+
+    int stack[OCTREE_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (node.absoluteStrength == 0.0f) {
+            continue;
+        }
+        glm::vec3 d = node.sourceCenter - glm::clamp(node.sourceCenter, targetMin, targetMax);
+        float distance2 = glm::dot(d, d);
+        float size = 2.0f * node.halfSize;
+        if (size * size < theta2 * distance2) {
+            interactions.push_back(glm::vec4(node.sourceCenter, node.strength));
+        } else if (node.leaf) {
+            interactions.insert(interactions.end(), sources.begin() + node.first, sources.begin() + node.first + node.count);
+        } else {
+            for (int c : node.children) {
+                if (c >= 0) {
+                    stack[top++] = c;
+                }
+            }
+        }
+    }
+}
+
+void Octree::applyForces(const LongRangeForce& settings) {
+    std::vector<int> leaves;
+    for (int i = 0; i < static_cast<int>(nodes.size()); i++) {
+        if (nodes[i].leaf) {
+            leaves.push_back(i);
+        }
+    }
+    const float softening2 = settings.softening * settings.softening;
+
+    #pragma omp parallel
+    {
+        std::vector<glm::vec4> interactions; // reused by the thread for all its leaves
+        // the leaves are in Morton order so neighbouring threads walk the same nodes
+        #pragma omp for schedule(dynamic, 16)
+        for (int l = 0; l < static_cast<int>(leaves.size()); l++) {
+            const Node& leaf = nodes[leaves[l]];
+            interactions.clear();
+            gatherInteractions(leaf, settings.theta, interactions);
+            const int count = static_cast<int>(interactions.size());
+            const glm::vec4* source = interactions.data();
+
+            for (int i = leaf.first; i < leaf.first + leaf.count; i++) {
+                Particle* p = bodies[i];
+                if (p->getInverseMass() == 0.0f) {
+                    continue;
+                }
+                // the gravity acceleration doesn't depend on the mass of the particle, the Coulomb one is q E / m (and repulsive for like charges)
+                float scale = settings.interaction == LongRangeForce::GRAVITY ? settings.constant : -settings.constant * p->charge * p->inverseMass;
+                if (scale == 0.0f) {
+                    continue;
+                }
+                // the body itself is in the list, its term (and the one of a coincident body) is masked since r2 is null without softening
+                const float px = sources[i].x, py = sources[i].y, pz = sources[i].z;
+                float fx = 0.0f, fy = 0.0f, fz = 0.0f;
+                #pragma omp simd reduction(+: fx, fy, fz)
+                for (int k = 0; k < count; k++) {
+                    float dx = source[k].x - px;
+                    float dy = source[k].y - py;
+                    float dz = source[k].z - pz;
+                    float r2 = dx * dx + dy * dy + dz * dz + softening2;
+                    float w = r2 > 0.0f ? source[k].w / (r2 * std::sqrt(r2)) : 0.0f;
+                    fx += dx * w;
+                    fy += dy * w;
+                    fz += dz * w;
+                }
+                p->addForce(glm::vec3(fx, fy, fz) * scale);
+            }
+        }
+    }
+}
+
+const std::vector<Octree::Node>& Octree::getNodes() const {
+    return nodes;
+}
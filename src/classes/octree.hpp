@@ -0,0 +1,39 @@
+#pragma once
+
+#include "particle.hpp"
+#include "longRangeForce.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+// Barnes-Hut octree, rebuilt every step from the particles
+// The particles are sorted along a Morton curve so every node covers a contiguous range of them
+class Octree {
+    public:
+        struct Node {
+            glm::vec3 center;
+            float halfSize;
+            glm::vec3 sourceCenter; // center of the sources, weighted by their absolute strength
+            float strength; // total mass or charge of the node
+            float absoluteStrength;
+            int children[8]; // -1 for an empty octant
+            bool leaf;
+            int first; // range of the sorted bodies under the node
+            int count;
+        };
+
+        void build(const std::vector<std::shared_ptr<Particle>>& particles, LongRangeForce::Interaction interaction);
+        void applyForces(const LongRangeForce& settings); // add the long range acceleration to every particle
+        glm::vec3 field(glm::vec3 point, float theta, float softening) const; // sum of strength * (r_j - point) / (d^2 + softening^2)^(3/2)
+
+        const std::vector<Node>& getNodes() const;
+
+    private:
+        std::vector<Node> nodes;
+        std::vector<Particle*> bodies; // sorted along the Morton curve
+        std::vector<glm::vec4> sources; // position and strength of the sorted bodies
+        std::vector<uint64_t> codes; // Morton codes of the sorted bodies
+
+        void gatherInteractions(const Node& target, float theta, std::vector<glm::vec4>& interactions) const; // sources acting on the bodies of a leaf
+};
@@ -31,4 +31,22 @@ void Particle::move(vec3 move) {
 
 void Particle::setUpdatingEnabled(bool enabled) {
     updatingEnabled = enabled;
+}
+
+void Particle::setMass(float mass) {
+    this->mass = mass;
+    this->inverseMass = mass > 0.0f ? 1.0f / mass : 0.0f; // a null mass is treated as an immovable particle
+}
+
+void Particle::applyWallResponse(vec3 unconstrainedPosition, vec3 normal, float restitution, float friction, vec3 wallDisplacement) {
+    // with Verlet integration the velocity is the displacement since the previous position, taken relative to the wall
+    vec3 velocity = unconstrainedPosition - previous_position - wallDisplacement;
+    float normalSpeed = dot(velocity, normal);
+    if (normalSpeed >= 0.0f) { // already moving away from the wall
+        return;
+    }
+    vec3 normalVelocity = normalSpeed * normal;
+    vec3 tangentVelocity = velocity - normalVelocity;
+    vec3 newVelocity = tangentVelocity * (1.0f - friction) - normalVelocity * restitution + wallDisplacement; // a moving wall carries the sphere along
+    previous_position = position - newVelocity;
 }
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include "plane.hpp"
 #include "container.hpp"
 #include <memory>
+#include <vector>
+#include <cstdint>
 
 
 using namespace glm;
@@ -12,6 +14,7 @@ using namespace glm;
 class Particle;
 class Sphere;
 class Container;
+class Fluid;
 
 class Particle {
     bool updatingEnabled = true;
@@ -19,10 +22,24 @@ class Particle {
 public:
     vec3 previous_position;
     vec3 position;
+    vec3 frame_position; // position at the end of the previous simulation frame, the renderer interpolates from it
     vec3 velocity;
     vec3 acceleration;
     
     bool fixed = false; // whether the particle is fixed in space
+    uint64_t id = 0; // stable id given by the simulation (never given to another particle, see Simulation::getParticle)
+    bool removed = false; // marked for removal, the simulation deletes it at the end of the step
+    float mass = 1.0f;
+    float inverseMass = 1.0f; // cached 1 / mass, a fixed particle is handled as an infinite mass
+    float charge = 0.0f; // used by the Coulomb long range force
+
+    // collision filtering
+    unsigned int collisionGroup = 1u; // bits of the groups the particle belongs to
+    unsigned int collisionMask = 0xFFFFFFFFu; // bits of the groups the particle can collide with
+    bool skipLinkedCollisions = false; // whether the contacts with the linked particles are ignored (the link already handles their distance)
+    std::vector<Particle*> linkedParticles; // particles linked to this one (filled by the molecules)
+    Fluid* fluid = nullptr; // fluid the particle belongs to, if any
+    int fluidIndex = -1; // index of the particle in its fluid
 
     virtual ~Particle() = default;
     virtual void updatePosition(float dt);
@@ -32,8 +49,35 @@ public:
     void addForce(vec3 force);
     void move(vec3 move); // move the particle by a certain amount
     void setUpdatingEnabled(bool enabled);
+    void setMass(float mass);
+    void applyWallResponse(vec3 unconstrainedPosition, vec3 normal, float restitution, float friction, vec3 wallDisplacement = vec3(0.0f)); // bounce and friction after a projection on a surface that moved by wallDisplacement during the step
+    float getInverseMass() const; // 0.0f for fixed particles
+    vec3 getRenderPosition(float alpha) const; // between the two last simulation frames (alpha = 1.0f for the current one)
+
+    static float collisionFilter(const Particle& a, const Particle& b); // 1.0f if the two particles should collide, 0.0f otherwise
 };
 
+inline float Particle::getInverseMass() const {
+    return fixed ? 0.0f : inverseMass;
+}
+
+inline vec3 Particle::getRenderPosition(float alpha) const {
+    return frame_position + (position - frame_position) * alpha;
+}
+
+inline float Particle::collisionFilter(const Particle& a, const Particle& b) {
+    // evaluated without branches so it can be folded into the contact response
+    unsigned int groups = static_cast<unsigned int>((a.collisionGroup & b.collisionMask) != 0u) & static_cast<unsigned int>((b.collisionGroup & a.collisionMask) != 0u);
+    unsigned int linked = 0u;
+    for (const Particle* p : a.linkedParticles) {
+        linked |= static_cast<unsigned int>(p == &b);
+    }
+    linked &= static_cast<unsigned int>(a.skipLinkedCollisions | b.skipLinkedCollisions);
+    // the particles of the same fluid are kept apart by its pressure instead of contacts
+    linked |= static_cast<unsigned int>(a.fluid == b.fluid) & static_cast<unsigned int>(a.fluid != nullptr);
+    return static_cast<float>(groups & ~linked & 1u);
+}
+
 // particle classes
 #include "particles/sphere.hpp"
 
@@ -0,0 +1,209 @@
+#include "particleMesh.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+#include <complex>
+#include <cmath>
+#include <algorithm>
+#include <omp.h>
+
+// radix 2 FFT of a contiguous line, twiddles[k] = exp(-2 i pi k / n) for k < n / 2
+static void fft(std::complex<float>* a, int n, const std::complex<float>* twiddles, bool inverse) {
+    // bit reversal permutation
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(a[i], a[j]);
+        }
+    }
+    for (int length = 2; length <= n; length <<= 1) {
+        int half = length / 2;
+        int step = n / length;
+        for (int i = 0; i < n; i += length) {
+            for (int k = 0; k < half; k++) {
+                std::complex<float> w = inverse ? std::conj(twiddles[k * step]) : twiddles[k * step];
+                std::complex<float> u = a[i + k];
+                std::complex<float> v = a[i + k + half] * w;
+                a[i + k] = u + v;
+                a[i + k + half] = u - v;
+            }
+        }
+    }
+}
+
+void ParticleMesh::fft3d(std::vector<std::complex<float>>& data, bool inverse) {
+    const int m = 2 * resolution;
+    #pragma omp parallel
+    {
+        std::vector<std::complex<float>> line(m); // the y and z lines are strided, they are copied to be transformed
+        // x lines are contiguous
+        #pragma omp for
+        for (int l = 0; l < m * m; l++) {
+            fft(&data[static_cast<size_t>(l) * m], m, twiddles.data(), inverse);
+        }
+        #pragma omp for
+        for (int l = 0; l < m * m; l++) {
+            int z = l / m, x = l % m;
+            size_t base = static_cast<size_t>(z) * m * m + x;
+            for (int y = 0; y < m; y++) line[y] = data[base + static_cast<size_t>(y) * m];
+            fft(line.data(), m, twiddles.data(), inverse);
+            for (int y = 0; y < m; y++) data[base + static_cast<size_t>(y) * m] = line[y];
+        }
+        #pragma omp for
+        for (int l = 0; l < m * m; l++) {
+            size_t base = static_cast<size_t>(l); // y * m + x
+            for (int z = 0; z < m; z++) line[z] = data[base + static_cast<size_t>(z) * m * m];
+            fft(line.data(), m, twiddles.data(), inverse);
+            for (int z = 0; z < m; z++) data[base + static_cast<size_t>(z) * m * m] = line[z];
+        }
+    }
+}
+
+void ParticleMesh::setupMesh(int requestedResolution, glm::vec3 min, glm::vec3 max) {
+    // the padded mesh is transformed with a radix 2 FFT
+    int n = 2;
+    while (n < requestedResolution) {
+        n *= 2;
+    }
+    // cubic cells, so the Green function is the same along every axis
+    float side = std::max(std::max(max.x - min.x, max.y - min.y), max.z - min.z);
+    spacing = std::max(side, 1e-4f) / static_cast<float>(n - 1);
+    origin = (min + max) / 2.0f - glm::vec3(spacing * static_cast<float>(n - 1) / 2.0f);
+
+    if (n != resolution) {
+        resolution = n;
+        const int m = 2 * n;
+        density.assign(static_cast<size_t>(n) * n * n, 0.0f);
+        field.assign(static_cast<size_t>(n) * n * n, glm::vec3(0.0f));
+        padded.assign(static_cast<size_t>(m) * m * m, 0.0f);
+        twiddles.resize(m / 2);
+        for (int k = 0; k < m / 2; k++) {
+            float angle = -2.0f * 3.14159265358979f * static_cast<float>(k) / static_cast<float>(m);
+            twiddles[k] = std::complex<float>(std::cos(angle), std::sin(angle));
+        }
+    }
+}
+
+void ParticleMesh::computeGreenSpectrum(float softening) {
+    if (greenResolution == resolution && greenSpacing == spacing && greenSoftening == softening) {
+        return;
+    }
+    const int n = resolution;
+    const int m = 2 * n;
+    // the mesh can't resolve anything below a cell, so the softening is at least the spacing (it also removes the self force)
+    const float s = std::max(softening, spacing);
+    greenSpectrum.assign(static_cast<size_t>(m) * m * m, 0.0f);
+    // the second half of every axis holds the negative offsets, the convolution is then not periodic over the original mesh
+    #pragma omp parallel for
+    for (int z = 0; z < m; z++) {
+        float dz = static_cast<float>(z < n ? z : z - m) * spacing;
+        for (int y = 0; y < m; y++) {
+            float dy = static_cast<float>(y < n ? y : y - m) * spacing;
+            for (int x = 0; x < m; x++) {
+                float dx = static_cast<float>(x < n ? x : x - m) * spacing;
+                greenSpectrum[(static_cast<size_t>(z) * m + y) * m + x] = 1.0f / std::sqrt(dx * dx + dy * dy + dz * dz + s * s);
+            }
+        }
+    }
+    fft3d(greenSpectrum, false);
+    greenResolution = resolution;
+    greenSpacing = spacing;
+    greenSoftening = softening;
+}
+
+void ParticleMesh::solve(const std::vector<std::shared_ptr<Particle>>& particles, glm::vec3 min, glm::vec3 max, const LongRangeForce& settings) {
+    setupMesh(settings.resolution, min, max);
+    computeGreenSpectrum(settings.softening);
+    const int n = resolution;
+    const int m = 2 * n;
+    const int numParticles = static_cast<int>(particles.size());
+    const float upper = static_cast<float>(n - 1) - 1e-4f;
+
+    // * cloud-in-cell deposit, every particle spreads its strength on the 8 nodes around it
+    std::fill(density.begin(), density.end(), 0.0f);
+    #pragma omp parallel for
+    for (int i = 0; i < numParticles; i++) {
+        const Particle* p = particles[i].get();
+        float strength = settings.interaction == LongRangeForce::GRAVITY ? p->mass : p->charge;
+        glm::vec3 q = (p->position - origin) / spacing;
+        if (strength == 0.0f || glm::any(glm::lessThan(q, glm::vec3(0.0f))) || glm::any(glm::greaterThan(q, glm::vec3(upper)))) {
+            continue;
+        }
+        glm::ivec3 c = glm::ivec3(q);
+        glm::vec3 f = q - glm::vec3(c);
+        for (int corner = 0; corner < 8; corner++) {
+            glm::ivec3 o = glm::ivec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+            float w = (o.x ? f.x : 1.0f - f.x) * (o.y ? f.y : 1.0f - f.y) * (o.z ? f.z : 1.0f - f.z);
+            size_t index = (static_cast<size_t>(c.z + o.z) * n + (c.y + o.y)) * n + (c.x + o.x);
+            #pragma omp atomic
+            density[index] += strength * w;
+        }
+    }
+
+    // * potential = density convolved with the Green function, as a product of the spectra
+    std::fill(padded.begin(), padded.end(), 0.0f);
+    #pragma omp parallel for
+    for (int z = 0; z < n; z++) {
+        for (int y = 0; y < n; y++) {
+            for (int x = 0; x < n; x++) {
+                padded[(static_cast<size_t>(z) * m + y) * m + x] = density[(static_cast<size_t>(z) * n + y) * n + x];
+            }
+        }
+    }
+    fft3d(padded, false);
+    const int total = m * m * m;
+    #pragma omp parallel for
+    for (int i = 0; i < total; i++) {
+        padded[i] *= greenSpectrum[i];
+    }
+    fft3d(padded, true);
+    const float normalization = 1.0f / static_cast<float>(total);
+
+    // * field = gradient of the potential, with central differences (one sided on the border)
+    auto potential = [&](int x, int y, int z) {
+        return padded[(static_cast<size_t>(z) * m + y) * m + x].real() * normalization;
+    };
+    #pragma omp parallel for
+    for (int z = 0; z < n; z++) {
+        for (int y = 0; y < n; y++) {
+            for (int x = 0; x < n; x++) {
+                int x0 = std::max(x - 1, 0), x1 = std::min(x + 1, n - 1);
+                int y0 = std::max(y - 1, 0), y1 = std::min(y + 1, n - 1);
+                int z0 = std::max(z - 1, 0), z1 = std::min(z + 1, n - 1);
+                field[(static_cast<size_t>(z) * n + y) * n + x] = glm::vec3(
+                    (potential(x1, y, z) - potential(x0, y, z)) / (static_cast<float>(x1 - x0) * spacing),
+                    (potential(x, y1, z) - potential(x, y0, z)) / (static_cast<float>(y1 - y0) * spacing),
+                    (potential(x, y, z1) - potential(x, y, z0)) / (static_cast<float>(z1 - z0) * spacing)
+                );
+            }
+        }
+    }
+
+    // * interpolate the field back with the cloud-in-cell weights
+    #pragma omp parallel for
+    for (int i = 0; i < numParticles; i++) {
+        Particle* p = particles[i].get();
+        if (p->getInverseMass() == 0.0f) {
+            continue;
+        }
+        // the gravity acceleration doesn't depend on the mass of the particle, the Coulomb one is q E / m (and repulsive for like charges)
+        float scale = settings.interaction == LongRangeForce::GRAVITY ? settings.constant : -settings.constant * p->charge * p->inverseMass;
+        glm::vec3 q = (p->position - origin) / spacing;
+        if (scale == 0.0f || glm::any(glm::lessThan(q, glm::vec3(0.0f))) || glm::any(glm::greaterThan(q, glm::vec3(upper)))) {
+            continue;
+        }
+        glm::ivec3 c = glm::ivec3(q);
+        glm::vec3 f = q - glm::vec3(c);
+        glm::vec3 e = glm::vec3(0.0f);
+        for (int corner = 0; corner < 8; corner++) {
+            glm::ivec3 o = glm::ivec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+            float w = (o.x ? f.x : 1.0f - f.x) * (o.y ? f.y : 1.0f - f.y) * (o.z ? f.z : 1.0f - f.z);
+            e += field[(static_cast<size_t>(c.z + o.z) * n + (c.y + o.y)) * n + (c.x + o.x)] * w;
+        }
+        p->addForce(e * scale);
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "particle.hpp"
+#include "longRangeForce.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+#include <complex>
+
+// Particle-mesh solver of the long range force
+// The particles are deposited on a regular mesh with cloud-in-cell, the potential comes from a zero padded FFT convolution (Hockney)
+// and the field is interpolated back on the particles with the same weights
+class ParticleMesh {
+    private:
+        int resolution = 0; // nodes along each axis of the mesh
+        float spacing = 0.0f; // distance between two nodes
+        glm::vec3 origin; // position of the first node
+        std::vector<float> density; // strength deposited on every node
+        std::vector<glm::vec3> field; // gradient of the potential on every node
+        std::vector<std::complex<float>> padded; // work mesh, twice the resolution along each axis
+        std::vector<std::complex<float>> twiddles;
+
+        // spectrum of the Green function, only rebuilt when the mesh changes
+        std::vector<std::complex<float>> greenSpectrum;
+        int greenResolution = 0;
+        float greenSpacing = 0.0f;
+        float greenSoftening = 0.0f;
+
+        void setupMesh(int resolution, glm::vec3 min, glm::vec3 max);
+        void computeGreenSpectrum(float softening);
+        void fft3d(std::vector<std::complex<float>>& data, bool inverse); // in place on the padded mesh
+
+    public:
+        // add the long range acceleration to every particle, the mesh covers the box [min, max] (the particles outside of it are ignored)
+        void solve(const std::vector<std::shared_ptr<Particle>>& particles, glm::vec3 min, glm::vec3 max, const LongRangeForce& settings);
+};
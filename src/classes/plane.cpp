@@ -9,21 +9,21 @@ Plane::Plane(glm::vec3 position, glm::vec3 normal, glm::vec2 size)
     : position(position), normal(normal), size(size) {
 
     normal = glm::normalize(normal);
+    this->normal = normal;
     float sx = size.x / 2; // in order to have the size of the plane centered at the position
     float sy = size.y / 2;
 
-    glm::vec3 u;
     std::vector<float> vertices;
-    // Create two perpendicular vectors on the plane
+    // Create two perpendicular vectors on the plane (kept for the collisions)
     if (glm::abs(glm::dot(normal, glm::vec3(1.0f, 0.0f, 0.0f))) < 0.0001f) {
-        u = glm::normalize(glm::cross(normal, glm::vec3(1.0f, 0.0f, 0.0f)));
+        this->u = glm::normalize(glm::cross(normal, glm::vec3(1.0f, 0.0f, 0.0f)));
     } else {
-        u = glm::normalize(glm::cross(normal, glm::vec3(0.0f, 1.0f, 0.0f)));
+        this->u = glm::normalize(glm::cross(normal, glm::vec3(0.0f, 1.0f, 0.0f)));
     }
+    this->v = glm::cross(normal, this->u);
         // Scale the vectors by the size of the plane
-    glm::vec3 v = glm::cross(normal, u);
-    u *= sx;
-    v *= sy;
+    glm::vec3 u = this->u * sx;
+    glm::vec3 v = this->v * sy;
     vertices = {
         // positions          // texture coords
         (position + u + v).x, (position + u + v).y, (position + u + v).z, sx, sy,
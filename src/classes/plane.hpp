@@ -9,6 +9,8 @@ class Plane {
     private:
         glm::vec3 position; // Center of the plane
         glm::vec3 normal; // Normal vector to the plane
+        glm::vec3 u; // unit vectors spanning the plane, computed once
+        glm::vec3 v;
         glm::vec2 size; // Size of the plane
         GLuint vao;
         GLuint vbo;
@@ -30,6 +32,14 @@ class Plane {
             return size;
         }
 
+        glm::vec3 getU() const {
+            return u;
+        }
+
+        glm::vec3 getV() const {
+            return v;
+        }
+
         GLuint getVao() const {
             return vao;
         }
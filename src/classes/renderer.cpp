@@ -8,14 +8,32 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glew.h>
 #include <fstream>
+#include <cmath>
 #include <sstream>
 #include <string>
 #include <iostream>
 #include <vector>
 #include <memory>
+#include <algorithm>
+#include <filesystem>
 #include "mesh.hpp"
+#include "grid.hpp"
+#include "../utils/culling.hpp"
+#include "../config.hpp"
 #include <omp.h>
 
+#define PACK_CHUNK_SIZE 4096 // spheres per task when there is no grid to cull with
+
+// projected radius in pixels above which each level of detail is used
+#define LOD_HIGH_PIXELS 32.0f
+#define LOD_LOW_PIXELS 6.0f
+#define LOD_POINT_PIXELS 0.75f // below, the sphere covers about a pixel
+
+#define CAMERA_UBO_BINDING 0 // binding point of the CameraMatrices block
+
+#define SHADER_CACHE_DIRECTORY "shader_cache" // in the working directory, next to the executable
+#define SHADER_DIRECTORY "../shaders" // watched for the hot reload
+
 void checkError(GLuint shaderProgram, const std::string& type) {
     if (shaderProgram == 0) {
         std::cerr << "Failed to create shader program of type " << type << std::endl;
@@ -23,60 +41,239 @@ void checkError(GLuint shaderProgram, const std::string& type) {
     }
 };
 
-Renderer::Renderer() {
-
-
+Renderer::Renderer() : shaderCache(SHADER_CACHE_DIRECTORY), linkStream(false, 2) {
+    shaderSources = {
+        {&shaderProgram, "particle", {{GL_VERTEX_SHADER, "shaders/vertexShader.glsl"}, {GL_GEOMETRY_SHADER, "shaders/geometryShader.glsl"}, {GL_FRAGMENT_SHADER, "shaders/fragmentShader.glsl"}}},
+        {&floorShaderProgram, "floor", {{GL_VERTEX_SHADER, "shaders/floorVertexShader.glsl"}, {GL_FRAGMENT_SHADER, "shaders/floorFragmentShader.glsl"}}},
+        {&modelShaderProgram, "model", {{GL_VERTEX_SHADER, "shaders/modelVertexShader.glsl"}, {GL_FRAGMENT_SHADER, "shaders/modelFragmentShader.glsl"}}},
+        {&containerShaderProgram, "container", {{GL_VERTEX_SHADER, "shaders/containerVertexShader.glsl"}, {GL_FRAGMENT_SHADER, "shaders/containerFragmentShader.glsl"}}},
+        {&moleculeLinksShaderProgram, "moleculeLinks", {{GL_VERTEX_SHADER, "shaders/modelOrientedVertexShader.glsl"}, {GL_FRAGMENT_SHADER, "shaders/modelFragmentShader.glsl"}}},
+        {&sphereShaderProgram, "sphere", {{GL_VERTEX_SHADER, "shaders/sphereVertexShader.glsl"}, {GL_FRAGMENT_SHADER, "shaders/modelFragmentShader.glsl"}}},
+        {&pointShaderProgram, "point", {{GL_VERTEX_SHADER, "shaders/pointVertexShader.glsl"}, {GL_FRAGMENT_SHADER, "shaders/pointFragmentShader.glsl"}}},
+    };
+
+    // * every build is started before waiting for any: the driver compiles them side by side when it has compiler threads
+    if (GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF); // as many as the driver wants
+    }
+    std::vector<ShaderBuild> builds;
+    for (const auto& source : shaderSources) {
+        builds.push_back(startShaderProgram(source.stages));
+    }
+    for (size_t i = 0; i < shaderSources.size(); i++) {
+        *shaderSources[i].program = finishShaderProgram(builds[i]);
+        checkError(*shaderSources[i].program, shaderSources[i].type);
+    }
 
-    // Create a shader program
-    shaderProgram = createShaderProgram("shaders/vertexShader.glsl", "shaders/geometryShader.glsl", "shaders/fragmentShader.glsl");
-    checkError(shaderProgram, "particle");
+    glGenVertexArrays(1, &impostorVao);
+    glGenBuffers(1, &depthPbo);
 
-    floorShaderProgram = createShaderProgram("shaders/floorVertexShader.glsl", "shaders/floorFragmentShader.glsl");
-    checkError(floorShaderProgram, "floor");
+    glGenBuffers(1, &cameraUbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, cameraUbo);
+    glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_UBO_BINDING, cameraUbo);
+}
 
-    modelShaderProgram = createShaderProgram("shaders/modelVertexShader.glsl", "shaders/modelFragmentShader.glsl");
-    checkError(modelShaderProgram, "model");
+void Renderer::updateCamera(const Camera& camera) {
+    // * a single upload per frame, the programs read the matrices from the buffer instead of their own uniforms
+    camera.loadMatricesIntoBuffer(cameraUbo);
+}
 
-    containerShaderProgram = createShaderProgram("shaders/containerVertexShader.glsl", "shaders/containerFragmentShader.glsl");
-    checkError(containerShaderProgram, "container");
+void Renderer::draw(const Camera& camera, const std::vector<std::shared_ptr<Sphere>>& spheres, const Grid* grid, size_t griddedSpheres) { // note : shared_ptr (*) meaning we take the pointer to the particle (and this allow polymorphism if we don't use the pointer we cannot use children classes) and the & meaning we take the reference to the particle
+    // * ray cast impostors: one point per sphere expanded to a quad by the geometry shader, same stream as the instanced meshes
+    size_t counts[LOD_COUNT];
+    packSpheres(camera, spheres, grid, griddedSpheres, false, counts);
 
-    moleculeLinksShaderProgram = createShaderProgram("shaders/modelOrientedVertexShader.glsl", "shaders/modelFragmentShader.glsl");
-    checkError(moleculeLinksShaderProgram, "moleculeLinks");
+    drawImpostors(0, counts[0]);
+    sphereStream.fence();
 }
 
-void Renderer::draw(const Camera& camera, const std::vector<std::shared_ptr<Sphere>>& spheres) { // note : shared_ptr (*) meaning we take the pointer to the particle (and this allow polymorphism if we don't use the pointer we cannot use children classes) and the & meaning we take the reference to the particle
-    std::vector<float> data;
-    for (const auto& sphere : spheres) { 
-        data.push_back(sphere->position.x);
-        data.push_back(sphere->position.y);
-        data.push_back(sphere->position.z);
-        data.push_back(sphere->radius); // TODO fix this later to render the sphere properly
+void Renderer::drawLod(const Camera& camera, const std::vector<std::shared_ptr<Sphere>>& spheres, Mesh& highMesh, Mesh& lowMesh, const Grid* grid, size_t griddedSpheres) {
+    // * one packed stream sorted by level of detail, each level is a range drawn by its own call
+    size_t counts[LOD_COUNT];
+    packSpheres(camera, spheres, grid, griddedSpheres, true, counts);
+
+    size_t first = 0;
+    highMesh.drawStream(sphereShaderProgram, sphereStream, counts[LOD_HIGH], first);
+    first += counts[LOD_HIGH];
+    lowMesh.drawStream(sphereShaderProgram, sphereStream, counts[LOD_LOW], first);
+    first += counts[LOD_LOW];
+    drawImpostors(first, counts[LOD_IMPOSTOR]);
+    first += counts[LOD_IMPOSTOR];
+
+    // sub pixel spheres: a single pixel each
+    glUseProgram(pointShaderProgram);
+    if (counts[LOD_POINT] > 0) {
+        glBindVertexArray(impostorVao);
+        sphereStream.bindAttribute(0, 0);
+        glDrawArrays(GL_POINTS, first, counts[LOD_POINT]);
+        glBindVertexArray(0);
     }
 
-    // Create a VBO and copy the data into it
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), data.data(), GL_STATIC_DRAW);
+    sphereStream.fence();
+}
 
+void Renderer::drawImpostors(size_t first, size_t count) {
     // Use the shader program
     glUseProgram(shaderProgram);
 
-    camera.loadMatricesIntoShader(shaderProgram);
+    if (count > 0) {
+        glBindVertexArray(impostorVao);
+        sphereStream.bindAttribute(0, 0);
+        glDrawArrays(GL_POINTS, first, count);
+        glBindVertexArray(0);
+    }
+}
+
+size_t Renderer::packSpheres(const Camera& camera, const std::vector<std::shared_ptr<Sphere>>& spheres, const Grid* grid, size_t griddedSpheres, bool lod, size_t counts[LOD_COUNT]) {
+    // * the spheres are packed straight into the mapped instance buffer, no intermediate arrays
+    glm::mat4 projection = camera.getProjectionMatrix(CAMERA_FOV, camera.aspectRatio, CAMERA_NEAR, CAMERA_FAR);
+    glm::mat4 viewProjection = projection * camera.getViewMatrix();
 
-    // Set up the vertex attribute pointers and draw the particles
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(3 * sizeof(float)));
+    // ranges of spheres to pack: the visible cells of the grid and the spheres added since it was built, or the whole list without a grid
+    std::vector<const std::vector<std::shared_ptr<Sphere>>*> ranges;
+    std::vector<std::pair<size_t, size_t>> bounds;
 
-    glDrawArrays(GL_POINTS, 0, spheres.size());
+    size_t firstUnculled = grid == nullptr ? 0 : std::min(griddedSpheres, spheres.size());
+    for (size_t i = firstUnculled; i < spheres.size(); i += PACK_CHUNK_SIZE) {
+        ranges.push_back(&spheres);
+        bounds.emplace_back(i, std::min(i + PACK_CHUNK_SIZE, spheres.size()));
+    }
+    if (grid != nullptr) {
+        Frustum frustum(viewProjection);
+        // the previous depth is only reliable while the camera doesn't move
+        bool occlusion = !hiZ.isEmpty() && hiZ.getViewProjection() == viewProjection;
+        // the spheres stick out of their cell by their radius and moved during the substep since the grid was built,
+        // and they are drawn between the two last frames, up to a whole frame of motion away from where the grid saw them
+        glm::vec3 margin(grid->getCellSize() + frameDisplacement);
+
+        std::vector<const std::vector<std::shared_ptr<Sphere>>*> cells;
+        std::vector<glm::ivec3> keys;
+        cells.reserve(grid->grid.size());
+        keys.reserve(grid->grid.size());
+        for (const auto& entry : grid->grid) {
+            keys.push_back(entry.first);
+            cells.push_back(&entry.second);
+        }
 
-    // Clean up
-    glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glDeleteBuffers(1, &vbo);
+        const int numCells = static_cast<int>(cells.size());
+        std::vector<unsigned char> visible(numCells);
+        #pragma omp parallel for schedule(static, 64)
+        for (int c = 0; c < numCells; c++) {
+            glm::vec3 min, max;
+            grid->getCellBounds(keys[c], min, max);
+            min -= margin;
+            max += margin;
+            visible[c] = frustum.intersectsBox(min, max) && !(occlusion && hiZ.isOccluded(min, max));
+        }
+        for (int c = 0; c < numCells; c++) {
+            if (visible[c] && !cells[c]->empty()) {
+                ranges.push_back(cells[c]);
+                bounds.emplace_back(0, cells[c]->size());
+            }
+        }
+    }
+
+    // projected radius in pixels = radius * pixelScale / depth
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    float pixelScale = 0.5f * viewport[3] * projection[1][1];
+    glm::vec3 eye = camera.position;
+    glm::vec3 forward = glm::normalize(camera.direction);
+    auto levelOf = [&](const Sphere& sphere) {
+        if (!lod) {
+            return 0;
+        }
+        float depth = glm::dot(sphere.position - eye, forward);
+        if (depth <= CAMERA_NEAR) {
+            return static_cast<int>(LOD_HIGH);
+        }
+        float pixels = sphere.radius * pixelScale / depth;
+        if (pixels >= LOD_HIGH_PIXELS) return static_cast<int>(LOD_HIGH);
+        if (pixels >= LOD_LOW_PIXELS) return static_cast<int>(LOD_LOW);
+        if (pixels >= LOD_POINT_PIXELS) return static_cast<int>(LOD_IMPOSTOR);
+        return static_cast<int>(LOD_POINT);
+    };
+
+    // count the spheres of every level in every range, then the offset of each range inside each level
+    const int numRanges = static_cast<int>(ranges.size());
+    std::vector<size_t> offsets((numRanges + 1) * LOD_COUNT, 0);
+    #pragma omp parallel for schedule(static, 64)
+    for (int r = 0; r < numRanges; r++) {
+        size_t* rangeCounts = &offsets[(r + 1) * LOD_COUNT];
+        for (size_t i = bounds[r].first; i < bounds[r].second; i++) {
+            const Sphere& sphere = *(*ranges[r])[i];
+            if (!sphere.removed) { // the grid keeps the spheres removed since it was built
+                rangeCounts[levelOf(sphere)]++;
+            }
+        }
+    }
+    for (int r = 0; r < numRanges; r++) {
+        for (int l = 0; l < LOD_COUNT; l++) {
+            offsets[(r + 1) * LOD_COUNT + l] += offsets[r * LOD_COUNT + l];
+        }
+    }
+
+    size_t count = 0;
+    size_t levelStart[LOD_COUNT];
+    for (int l = 0; l < LOD_COUNT; l++) {
+        counts[l] = offsets[numRanges * LOD_COUNT + l];
+        levelStart[l] = count;
+        count += counts[l];
+    }
+
+    void* data = sphereStream.begin(count);
+
+    #pragma omp parallel for schedule(static, 64)
+    for (int r = 0; r < numRanges; r++) {
+        size_t offset[LOD_COUNT];
+        for (int l = 0; l < LOD_COUNT; l++) {
+            offset[l] = levelStart[l] + offsets[r * LOD_COUNT + l];
+        }
+        for (size_t i = bounds[r].first; i < bounds[r].second; i++) {
+            const Sphere& sphere = *(*ranges[r])[i];
+            if (sphere.removed) {
+                continue;
+            }
+            sphereStream.write(data, offset[levelOf(sphere)]++, sphere.getRenderPosition(interpolation), sphere.radius);
+        }
+    }
+
+    sphereStream.end();
+    return count;
+}
+
+void Renderer::captureOcclusionDepth(const Camera& camera) {
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, depthPbo);
+
+    // * build the HiZ pyramid from the read back of the previous frame, it had a whole frame to complete
+    if (depthPending) {
+        const float* depth = static_cast<const float*>(glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+        if (depth != nullptr) {
+            hiZ.build(depth, depthWidth, depthHeight, depthViewProjection);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        } else {
+            hiZ.clear();
+        }
+        depthPending = false;
+    }
+
+    if (viewport[2] != depthWidth || viewport[3] != depthHeight) {
+        depthWidth = viewport[2];
+        depthHeight = viewport[3];
+        glBufferData(GL_PIXEL_PACK_BUFFER, depthWidth * depthHeight * sizeof(float), NULL, GL_STREAM_READ);
+    }
+
+    // asynchronous: glReadPixels into a pixel buffer returns without waiting for the GPU
+    glReadPixels(viewport[0], viewport[1], depthWidth, depthHeight, GL_DEPTH_COMPONENT, GL_FLOAT, (void*)0);
+    depthViewProjection = camera.getProjectionMatrix(CAMERA_FOV, camera.aspectRatio, CAMERA_NEAR, CAMERA_FAR) * camera.getViewMatrix();
+    depthPending = true;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
 }
 
 GLuint Renderer::loadAndCompileShader(const std::string& filename, GLenum shaderType) {
@@ -91,171 +288,231 @@ GLuint Renderer::loadAndCompileShader(const std::string& filename, GLenum shader
     std::string shaderSrc = fileStream.str();
     const char* shaderSrcCStr = shaderSrc.c_str();
 
-    // Create the shader
+    // Create the shader, the compilation status is only read once the program is linked (so the compilation can run in the background)
     GLuint shader = glCreateShader(shaderType);
     glShaderSource(shader, 1, &shaderSrcCStr, nullptr);
     glCompileShader(shader);
 
-    // Check for errors
-    GLint success;
-    GLchar infoLog[512];
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(shader, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
-        return 0;
-    }
-
     return shader;
 }
 
 GLuint Renderer::createShaderProgram(const std::string& vertexShaderFile, const std::string& fragmentShaderFile) {
-    // Load the vertex shader
-    GLuint vertexShader = loadAndCompileShader(vertexShaderFile, GL_VERTEX_SHADER);
-    checkError(vertexShader, "vertex");
-
-    // Load the fragment shader
-    GLuint fragmentShader = loadAndCompileShader(fragmentShaderFile, GL_FRAGMENT_SHADER);
-    checkError(fragmentShader, "fragment");
+    ShaderBuild build = startShaderProgram({{GL_VERTEX_SHADER, vertexShaderFile}, {GL_FRAGMENT_SHADER, fragmentShaderFile}});
+    return finishShaderProgram(build);
+}
 
-    // Create the shader program
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
+GLuint Renderer::createShaderProgram(const std::string& vertexShaderFile, const std::string& geometryShaderFile, const std::string& fragmentShaderFile) {
+    ShaderBuild build = startShaderProgram({{GL_VERTEX_SHADER, vertexShaderFile}, {GL_GEOMETRY_SHADER, geometryShaderFile}, {GL_FRAGMENT_SHADER, fragmentShaderFile}});
+    return finishShaderProgram(build);
+}
 
-    // Clean up
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+Renderer::ShaderBuild Renderer::startShaderProgram(const std::vector<std::pair<GLenum, std::string>>& stages) {
+    ShaderBuild build;
 
-    return shaderProgram;
-}
+    // the key covers the sources as they are now on disk, an edited shader is a miss
+    std::vector<std::string> sources;
+    for (const auto& stage : stages) {
+        std::ifstream file("../" + stage.second);
+        std::stringstream fileStream;
+        fileStream << file.rdbuf();
+        sources.push_back(stage.second + "\n" + fileStream.str());
 
-GLuint Renderer::createShaderProgram(const std::string& vertexShaderFile, const std::string& geometryShaderFile, const std::string& fragmentShaderFile) {
-    // Load the vertex shader
-    GLuint vertexShader = loadAndCompileShader(vertexShaderFile, GL_VERTEX_SHADER);
-    checkError(vertexShader, "vertex");
+        std::string stem = std::filesystem::path(stage.second).stem().string();
+        build.cacheName += build.cacheName.empty() ? stem : "_" + stem;
+    }
+    build.key = shaderCache.getKey(sources);
 
-    // Load the geometry shader
-    GLuint geometryShader = loadAndCompileShader(geometryShaderFile, GL_GEOMETRY_SHADER);
-    checkError(geometryShader, "geometry");
+    build.program = shaderCache.load(build.cacheName, build.key);
+    if (build.program != 0) {
+        return build;
+    }
 
-    // Load the fragment shader
-    GLuint fragmentShader = loadAndCompileShader(fragmentShaderFile, GL_FRAGMENT_SHADER);
-    checkError(fragmentShader, "fragment");
+    for (const auto& stage : stages) {
+        GLuint shader = loadAndCompileShader(stage.second, stage.first);
+        if (shader == 0) {
+            for (GLuint compiled : build.shaders) {
+                glDeleteShader(compiled);
+            }
+            build.shaders.clear();
+            return build;
+        }
+        build.shaders.push_back(shader);
+    }
 
     // Create the shader program
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, geometryShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
+    build.program = glCreateProgram();
+    if (shaderCache.isEnabled()) {
+        glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    for (GLuint shader : build.shaders) {
+        glAttachShader(build.program, shader);
+    }
+    glLinkProgram(build.program);
 
-    // Clean up
-    glDeleteShader(vertexShader);
-    glDeleteShader(geometryShader);
-    glDeleteShader(fragmentShader);
+    return build;
+}
 
-    return shaderProgram;
+bool Renderer::isShaderProgramReady(const ShaderBuild& build) const {
+    if (build.program == 0 || build.shaders.empty() || !GLEW_ARB_parallel_shader_compile) {
+        return true;
+    }
+    GLint completed = GL_FALSE;
+    glGetProgramiv(build.program, GL_COMPLETION_STATUS_ARB, &completed);
+    return completed == GL_TRUE;
 }
 
-void Renderer::draw(const Camera& camera, const std::vector<std::shared_ptr<Sphere>>& spheres, Mesh& mesh) {
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec3> scales;
+GLuint Renderer::finishShaderProgram(ShaderBuild& build) {
+    if (build.program == 0) {
+        return 0;
+    }
 
-    positions.reserve(spheres.size());
-    scales.reserve(spheres.size());
-    
-    for (const auto& s : spheres) {
-        positions.emplace_back(s->position);
-        scales.emplace_back(glm::vec3(s->radius));
+    GLint success;
+    glGetProgramiv(build.program, GL_LINK_STATUS, &success);
+    if (!success) {
+        // Check for errors
+        GLchar infoLog[512];
+        for (GLuint shader : build.shaders) {
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+            if (!success) {
+                glGetShaderInfoLog(shader, 512, NULL, infoLog);
+                std::cerr << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
+            }
+        }
+        glGetProgramInfoLog(build.program, 512, NULL, infoLog);
+        std::cerr << "ERROR::SHADER::LINKING_FAILED\n" << infoLog << std::endl;
+        glDeleteProgram(build.program);
+        build.program = 0;
+    } else if (!build.shaders.empty()) {
+        shaderCache.save(build.cacheName, build.key, build.program);
     }
 
-    // Use the shader program
-    mesh.draw(modelShaderProgram, camera, positions, scales);
+    // Clean up
+    for (GLuint shader : build.shaders) {
+        glDeleteShader(shader);
+    }
+    build.shaders.clear();
+
+    if (build.program != 0) {
+        setupShaderProgram(build.program); // the binary of the cache doesn't keep the block bindings nor the uniform values
+    }
+    return build.program;
 }
 
-void Renderer::drawMoleculeLinks(const Camera& camera, const std::vector<std::shared_ptr<Molecule>>& molecules, Mesh& mesh) {
-    std::vector<glm::vec3> positions;
-    std::vector<glm::vec3> scales;
-    std::vector<glm::vec3> rotations; // New vector for the rotation matrices
-
-    for (const auto& molecule : molecules) {
-        for (int i = 0; i < molecule->links.size(); i++) {
-            std::shared_ptr<Sphere> s1 = molecule->links[i].first;
-            std::shared_ptr<Sphere> s2 = molecule->links[i].second;
-            glm::vec3 center = (s1->position + s2->position) / 2.0f;
-            float distance = glm::length(s1->position - s2->position);
-            positions.push_back(center);
-            scales.push_back(glm::vec3(s1->radius / 2, distance / 2, s1->radius / 2));
-            // scales.push_back(glm::vec3(0.25f));
-
-            // Calculate the direction vector of the link
-            glm::vec3 axis = glm::normalize(s2->position - s1->position);
-            glm::vec3 modelUp = glm::vec3(0.0f, 1.0f, 0.0f);
-            glm::vec3 modelX = glm::vec3(1.0f, 0.0f, 0.0f);
-            glm::vec3 modelZ = glm::vec3(0.0f, 0.0f, 1.0f);
-
-            // get the dot product of the axis and modelUp vectors
-            float dotProduct = glm::dot(axis, modelUp);
-
-            // clamp the value to the range [-1.0, 1.0] to avoid precision issues
-            dotProduct = glm::clamp(dotProduct, -1.0f, 1.0f);
-
-            // get the angle between the up axis and the axis
-            float angleX = glm::degrees(acos(dotProduct));
-
-            // get the cross product of the axis and modelUp vectors
-            glm::vec3 crossProductX = glm::cross(axis, modelUp);
-
-            // adjust the sign of the angle based on the direction of the cross product
-            if (glm::dot(modelUp, crossProductX) < 0) {
-                angleX = -angleX;
-            }
-            
-            // get the projection of the axis on the xz plane
-            glm::vec3 axisXZ = glm::normalize(axis - glm::dot(axis, modelUp) * modelUp);
+void Renderer::setupShaderProgram(GLuint program) {
+    // * everything the draws would look up is resolved here, once: no glGetUniformLocation nor matrix upload per draw
+    GLuint cameraBlock = glGetUniformBlockIndex(program, "CameraMatrices");
+    if (cameraBlock != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, cameraBlock, CAMERA_UBO_BINDING);
+    }
 
-            // get the cross product of the axisXZ and modelZ vectors
-            glm::vec3 crossProduct = glm::cross(axisXZ, modelZ);
+    // the samplers never change unit, the n-th sampler of the program reads texture unit n
+    glUseProgram(program);
+    GLint numUniforms = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &numUniforms);
+    GLint unit = 0;
+    for (GLint i = 0; i < numUniforms; i++) {
+        GLchar name[256];
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(program, i, sizeof(name), NULL, &size, &type, name);
+        if (type == GL_SAMPLER_2D) {
+            glUniform1i(glGetUniformLocation(program, name), unit++);
+        }
+    }
+    glUseProgram(0);
+}
 
-            // get the angle between the z axis and the projection of the axis on the xz plane
-            float angleY = glm::degrees(atan2(glm::length(crossProduct), glm::dot(axisXZ, modelZ)));
+void Renderer::enableShaderHotReload() {
+    if (!shaderWatcher) {
+        shaderWatcher = std::make_unique<FileWatcher>(SHADER_DIRECTORY);
+        std::cout << "Watching " << SHADER_DIRECTORY << " for shader changes" << std::endl;
+    }
+}
 
-            // check nan
-            if (isnan(angleY)) {
-                angleY = 0.0f;
-            }
+void Renderer::reloadShaders() {
+    if (!shaderWatcher) {
+        return;
+    }
 
-            if (glm::dot(modelUp, crossProduct) < 0) {
-                angleY = -angleY;
-            }
+    // start the builds of the programs using an edited file, they are compiled while the old programs keep drawing
+    std::vector<std::string> changes = shaderWatcher->takeChanges();
+    for (size_t i = 0; i < shaderSources.size() && !changes.empty(); i++) {
+        bool edited = false;
+        for (const auto& stage : shaderSources[i].stages) {
+            std::string name = std::filesystem::path(stage.second).filename().string();
+            edited = edited || std::find(changes.begin(), changes.end(), name) != changes.end();
+        }
+        if (edited) {
+            pendingReloads.emplace_back(i, startShaderProgram(shaderSources[i].stages));
+        }
+    }
 
-            angleY = angleY + 180.0f;
+    for (size_t p = 0; p < pendingReloads.size();) {
+        auto& [index, build] = pendingReloads[p];
+        if (!isShaderProgramReady(build)) {
+            p++;
+            continue;
+        }
+        const ShaderProgramSource& source = shaderSources[index];
+        GLuint program = finishShaderProgram(build);
+        if (program != 0) {
+            glDeleteProgram(*source.program);
+            *source.program = program;
+            std::cout << "Reloaded the " << source.type << " shader program" << std::endl;
+        } else {
+            std::cerr << "Keeping the previous " << source.type << " shader program" << std::endl;
+        }
+        pendingReloads.erase(pendingReloads.begin() + p);
+    }
+}
 
-            glm::vec3 rotation = glm::vec3(angleX, angleY, 0.0f);
-            rotations.push_back(rotation); // Add the rotation angles to the vector
+void Renderer::draw(const Camera& camera, const std::vector<std::shared_ptr<Sphere>>& spheres, Mesh& mesh, const Grid* grid, size_t griddedSpheres) {
+    size_t counts[LOD_COUNT];
+    size_t count = packSpheres(camera, spheres, grid, griddedSpheres, false, counts);
+
+    mesh.drawStream(sphereShaderProgram, sphereStream, count);
+    sphereStream.fence();
+}
 
+void Renderer::drawMoleculeLinks(const std::vector<std::shared_ptr<Molecule>>& molecules, Mesh& mesh) {
+    // * each link is streamed as its two ends, the cylinder is oriented in the vertex shader (no trigonometry on the CPU)
+    size_t count = 0;
+    std::vector<size_t> offsets(molecules.size());
+    for (size_t m = 0; m < molecules.size(); m++) {
+        offsets[m] = count;
+        count += molecules[m]->links.size();
+    }
+
+    void* data = linkStream.begin(count);
+
+    #pragma omp parallel
+    for (size_t m = 0; m < molecules.size(); m++) {
+        const auto& links = molecules[m]->links;
+        const int numLinks = static_cast<int>(links.size());
+        #pragma omp for schedule(static) nowait
+        for (int i = 0; i < numLinks; i++) {
+            const Sphere& s1 = *links[i].first;
+            const Sphere& s2 = *links[i].second;
+            linkStream.write(data, offsets[m] + i, s1.getRenderPosition(interpolation), s1.radius / 2, 0); // radius of the cylinder
+            linkStream.write(data, offsets[m] + i, s2.getRenderPosition(interpolation), 0.0f, 1);
         }
     }
 
-    mesh.drawOriented(moleculeLinksShaderProgram, camera, positions, scales, rotations); // Pass the rotation matrices to the draw function
+    linkStream.end();
+    mesh.drawStream(moleculeLinksShaderProgram, linkStream, count);
+    linkStream.fence();
 }
 
-void Renderer::drawPlanes(const Camera& camera, const std::vector<std::shared_ptr<Plane>>& planes) {
+void Renderer::drawPlanes(const std::vector<std::shared_ptr<Plane>>& planes) {
     // Use the shader program
     glUseProgram(floorShaderProgram);
 
-   camera.loadMatricesIntoShader(floorShaderProgram);
-
+    // the texture1 sampler reads unit 0 since the program was linked
+    glActiveTexture(GL_TEXTURE0);
     for (const auto& plane : planes) {
         // Bind the floor texture
-        glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, plane->getTexture());
 
-        // Set the texture uniform
-        glUniform1i(glGetUniformLocation(floorShaderProgram, "texture1"), 0);
-
         // Bind the floor VAO and draw the floor
         glBindVertexArray(plane->getVao());
         glDrawArrays(GL_TRIANGLES, 0, 6);
@@ -266,15 +523,46 @@ void Renderer::drawPlanes(const Camera& camera, const std::vector<std::shared_pt
     }
 }
 
-void Renderer::drawContainer(const Camera& camera, const std::vector<std::shared_ptr<Container>>& containers, Mesh& mesh) {
+// unit quaternion (x, y, z, w) of a rotation matrix, from the largest of its diagonal terms to stay accurate near half turns
+static glm::vec4 toQuaternion(const glm::mat3& m) {
+    float trace = m[0][0] + m[1][1] + m[2][2];
+    glm::vec4 q;
+    if (trace > 0.0f) {
+        float s = std::sqrt(trace + 1.0f) * 2.0f;
+        q = glm::vec4((m[1][2] - m[2][1]) / s, (m[2][0] - m[0][2]) / s, (m[0][1] - m[1][0]) / s, 0.25f * s);
+    } else if (m[0][0] > m[1][1] && m[0][0] > m[2][2]) {
+        float s = std::sqrt(1.0f + m[0][0] - m[1][1] - m[2][2]) * 2.0f;
+        q = glm::vec4(0.25f * s, (m[1][0] + m[0][1]) / s, (m[2][0] + m[0][2]) / s, (m[1][2] - m[2][1]) / s);
+    } else if (m[1][1] > m[2][2]) {
+        float s = std::sqrt(1.0f + m[1][1] - m[0][0] - m[2][2]) * 2.0f;
+        q = glm::vec4((m[1][0] + m[0][1]) / s, 0.25f * s, (m[2][1] + m[1][2]) / s, (m[2][0] - m[0][2]) / s);
+    } else {
+        float s = std::sqrt(1.0f + m[2][2] - m[0][0] - m[1][1]) * 2.0f;
+        q = glm::vec4((m[2][0] + m[0][2]) / s, (m[2][1] + m[1][2]) / s, 0.25f * s, (m[0][1] - m[1][0]) / s);
+    }
+    return glm::normalize(q);
+}
+
+void Renderer::drawContainer(const std::vector<std::shared_ptr<Container>>& containers, Mesh& mesh) {
     std::vector<glm::vec3> positions;
     std::vector<glm::vec3> scales;
+    std::vector<glm::vec4> rotations; // drawn in the same frame as they collide
 
     for (const auto& container : containers) {
         positions.push_back(container->position);
         scales.push_back(container->size);
+        rotations.push_back(toQuaternion(container->orientation));
     }
 
     // Use the shader program
-    mesh.draw(containerShaderProgram, camera, positions, scales);
+    mesh.drawOriented(containerShaderProgram, positions, scales, rotations);
 }
+
+
+void Renderer::drawMeshCollider(const std::shared_ptr<MeshCollider>& collider, Mesh& mesh) {
+    std::vector<glm::vec3> positions = {collider->position};
+    std::vector<glm::vec3> scales = {glm::vec3(collider->scale)};
+    std::vector<glm::vec4> rotations = {glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)}; // the colliders are static and not rotated
+
+    mesh.drawOriented(containerShaderProgram, positions, scales, rotations);
+}
\ No newline at end of file
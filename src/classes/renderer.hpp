@@ -7,16 +7,39 @@
 #include "mesh.hpp"
 #include "container.hpp"
 #include "molecule.hpp"
+#include "meshCollider.hpp"
+#include "instanceStream.hpp"
+#include "shaderCache.hpp"
+#include "grid.hpp"
+#include "../utils/culling.hpp"
+#include "../utils/file_watcher.hpp"
 #include <glew.h>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <memory>
 
+// levels of detail of the spheres, by projected radius
+enum SphereLod { LOD_HIGH, LOD_LOW, LOD_IMPOSTOR, LOD_POINT, LOD_COUNT };
+
 class Renderer {
 
 private:
+    struct ShaderProgramSource {
+        GLuint* program; // member of the renderer, replaced when the program is reloaded
+        std::string type; // for the error messages
+        std::vector<std::pair<GLenum, std::string>> stages; // shader type and file of every stage
+    };
+
+    struct ShaderBuild { // a program compiled and linked by the driver, possibly in its own threads
+        GLuint program = 0;
+        std::vector<GLuint> shaders; // empty when the program comes from the cache
+        std::string cacheName;
+        uint64_t key = 0;
+    };
+
     GLuint shaderProgram;
+    GLuint impostorVao; // points read from the sphere stream
     GLuint floorShaderProgram;
     GLuint floorVao;
     GLuint floorVbo;
@@ -24,16 +47,54 @@ private:
     GLuint modelShaderProgram;
     GLuint containerShaderProgram;
     GLuint moleculeLinksShaderProgram;
+    GLuint sphereShaderProgram;
+    GLuint pointShaderProgram;
+    GLuint cameraUbo; // view and projection matrices shared by all the programs
+
+    ShaderCache shaderCache;
+    std::vector<ShaderProgramSource> shaderSources;
+    std::unique_ptr<FileWatcher> shaderWatcher; // only with hot reload
+    std::vector<std::pair<size_t, ShaderBuild>> pendingReloads; // index in shaderSources and new program
+    InstanceStream sphereStream; // interleaved position and radius of the spheres
+    InstanceStream linkStream; // two ends per link, the first one with the radius of the cylinder
+    float interpolation = 1.0f; // position of the drawn state between the two last simulation frames
+    float frameDisplacement = 0.0f; // largest distance between the two last simulation frames of a sphere, the drawn spheres lag the grid by up to this
+
+    // occlusion culling against the depth of the previous frames, read back asynchronously
+    HiZBuffer hiZ;
+    GLuint depthPbo = 0;
+    int depthWidth = 0, depthHeight = 0;
+    bool depthPending = false; // a read back was issued and not consumed yet
+    glm::mat4 depthViewProjection; // matrix of the pending read back
+
+    // write the visible spheres in the stream sorted by level of detail (all in the first level without lod), returns their number
+    size_t packSpheres(const Camera& camera, const std::vector<std::shared_ptr<Sphere>>& spheres, const Grid* grid, size_t griddedSpheres, bool lod, size_t counts[LOD_COUNT]);
+    void drawImpostors(size_t first, size_t count);
 
     GLuint loadAndCompileShader(const std::string& filename, GLenum shaderType);
+    // start the build of a program: from the binary cache, or compile and link without waiting (the driver may do it in its threads)
+    ShaderBuild startShaderProgram(const std::vector<std::pair<GLenum, std::string>>& stages);
+    bool isShaderProgramReady(const ShaderBuild& build) const; // whether finishing the build would not wait for the driver
+    GLuint finishShaderProgram(ShaderBuild& build); // check the link, save the binary and do the link time setup: 0 on failure
+    void setupShaderProgram(GLuint program); // camera block binding and texture units of the samplers
 
 public:
     Renderer();
-    void draw(const Camera& camera, const std::vector<std::shared_ptr<Sphere>>& spheres);
-    void draw(const Camera& camera, const std::vector<std::shared_ptr<Sphere>>& spheres, Mesh& mesh);
-    void drawMoleculeLinks(const Camera& camera, const std::vector<std::shared_ptr<Molecule>>& molecules, Mesh& mesh);
-    void drawPlanes(const Camera& camera, const std::vector<std::shared_ptr<Plane>>& planes);
-    void drawContainer(const Camera& camera, const std::vector<std::shared_ptr<Container>>& containers, Mesh& mesh);
+    void updateCamera(const Camera& camera); // once per frame, before the draws
+    void enableShaderHotReload(); // watch the shaders directory, the edited programs are relinked while the rendering goes on
+    void reloadShaders(); // once per frame, swaps the programs relinked successfully
+    // with a grid holding the first griddedSpheres spheres, only its cells in the view frustum and not occluded are drawn
+    // (its removed spheres are skipped), the spheres added since it was built are drawn without culling
+    void draw(const Camera& camera, const std::vector<std::shared_ptr<Sphere>>& spheres, const Grid* grid = nullptr, size_t griddedSpheres = 0);
+    void draw(const Camera& camera, const std::vector<std::shared_ptr<Sphere>>& spheres, Mesh& mesh, const Grid* grid = nullptr, size_t griddedSpheres = 0);
+    void drawLod(const Camera& camera, const std::vector<std::shared_ptr<Sphere>>& spheres, Mesh& highMesh, Mesh& lowMesh, const Grid* grid = nullptr, size_t griddedSpheres = 0);
+    void captureOcclusionDepth(const Camera& camera); // to call once the opaque objects are drawn
+    void drawMoleculeLinks(const std::vector<std::shared_ptr<Molecule>>& molecules, Mesh& mesh);
+    void drawPlanes(const std::vector<std::shared_ptr<Plane>>& planes);
+    void drawContainer(const std::vector<std::shared_ptr<Container>>& containers, Mesh& mesh);
+    void drawMeshCollider(const std::shared_ptr<MeshCollider>& collider, Mesh& mesh);
+    void setInterpolation(float alpha, float frameDisplacement) { interpolation = alpha; this->frameDisplacement = frameDisplacement; }
+    void setHalfPrecisionInstances(bool halfPrecision) { sphereStream.setHalfPrecision(halfPrecision); }
     GLuint createShaderProgram(const std::string& vertexShaderFile, const std::string& fragmentShaderFile);
     GLuint createShaderProgram(const std::string& vertexShaderFile, const std::string& geometryShaderFile, const std::string& fragmentShaderFile);
 };
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "shaderCache.hpp"
+#include <glew.h>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <random>
+#include <vector>
+#include <iterator>
+
+#define SHADER_CACHE_MAGIC 0x31425053u // "SPB1", version of the file layout
+
+struct ShaderCacheHeader {
+    uint32_t magic;
+    uint32_t format; // binary format given by the driver
+    uint64_t key;
+};
+
+static uint64_t hashBytes(uint64_t hash, const std::string& bytes) {
+    // FNV-1a 64 bits, the length is hashed too so that the concatenation of the sources is not ambiguous
+    uint64_t length = bytes.size();
+    for (int i = 0; i < 8; i++) {
+        hash = (hash ^ ((length >> (8 * i)) & 0xFF)) * 1099511628211ull;
+    }
+    for (unsigned char byte : bytes) {
+        hash = (hash ^ byte) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static std::string getGLString(GLenum name) {
+    const GLubyte* value = glGetString(name);
+    return value != nullptr ? reinterpret_cast<const char*>(value) : "";
+}
+
+ShaderCache::ShaderCache(const std::string& directory) : directory(directory) {
+    driver = getGLString(GL_VENDOR) + "\n" + getGLString(GL_RENDERER) + "\n" + getGLString(GL_VERSION);
+
+    GLint numFormats = 0;
+    if (GLEW_ARB_get_program_binary) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    }
+    if (numFormats == 0) {
+        return; // ! some drivers expose the extension without any format
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Shader cache disabled, failed to create " << directory << ": " << error.message() << std::endl;
+        return;
+    }
+    enabled = true;
+}
+
+uint64_t ShaderCache::getKey(const std::vector<std::string>& sources) const {
+    uint64_t hash = hashBytes(14695981039346656037ull, driver);
+    for (const auto& source : sources) {
+        hash = hashBytes(hash, source);
+    }
+    return hash;
+}
+
+std::string ShaderCache::getPath(const std::string& name) const {
+    return directory + "/" + name + ".bin";
+}
+
+GLuint ShaderCache::load(const std::string& name, uint64_t key) const {
+    if (!enabled) {
+        return 0;
+    }
+    std::ifstream file(getPath(name), std::ios::binary);
+    if (!file) {
+        return 0;
+    }
+
+    ShaderCacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != SHADER_CACHE_MAGIC || header.key != key) {
+        return 0; // another version of the sources or of the driver, replaced when the program is saved
+    }
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (binary.empty()) {
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+    // the driver may reject a binary it produced itself (after an update keeping the same strings)
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void ShaderCache::save(const std::string& name, uint64_t key, GLuint program) const {
+    if (!enabled) {
+        return;
+    }
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    ShaderCacheHeader header = {SHADER_CACHE_MAGIC, 0, key};
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(program, length, NULL, &format, binary.data());
+    header.format = format;
+
+    // written next to the final file then renamed: runs started at the same time never read a partial file
+    std::string path = getPath(name);
+    std::string temporary = path + "." + std::to_string(std::random_device{}()) + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), binary.size());
+        if (!file) {
+            std::cerr << "Failed to write the shader cache " << temporary << std::endl;
+            return;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+    }
+}
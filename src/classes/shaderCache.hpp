@@ -0,0 +1,25 @@
+#pragma once
+
+#include <glew.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// * linked program binaries saved on disk, keyed by the hash of the sources and of the driver
+// a program is only compiled from source the first time, or after a shader or the driver changed
+class ShaderCache {
+public:
+    ShaderCache(const std::string& directory); // needs the OpenGL context
+
+    bool isEnabled() const { return enabled; } // false without GL_ARB_get_program_binary or a writable directory
+    uint64_t getKey(const std::vector<std::string>& sources) const;
+    GLuint load(const std::string& name, uint64_t key) const; // linked program, 0 on a miss
+    void save(const std::string& name, uint64_t key, GLuint program) const; // the program must be linked with the retrievable hint
+
+private:
+    std::string directory;
+    std::string driver; // vendor, renderer and version strings: a binary is only valid for the driver that produced it
+    bool enabled = false;
+
+    std::string getPath(const std::string& name) const;
+};
@@ -8,8 +8,13 @@
 #include <fstream>
 #include <json.hpp>
 #include <memory>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
 #include <glm/glm.hpp>
 #include "../utils/parser.hpp"
+#include "../utils/contact_kernel.hpp"
 #include "../config.hpp"
 #ifndef _OPENMP
     #define _OPENMP 0
@@ -17,6 +22,12 @@
 
 using json = nlohmann::json;
 
+#define TASK_CHUNKS_PER_THREAD 8 // tasks per stage and per thread, enough for the stealing to even out cells of uneven cost
+#define LINK_CHUNK_SIZE 256 // links of a color per task
+#define ID_SLOT_BITS 32 // low bits of a particle id, the slot in idToIndex (the high bits are its generation)
+#define ID_SLOT_MASK ((uint64_t(1) << ID_SLOT_BITS) - 1)
+#define ID_LAST_GENERATION 0xFFFFFFFFu // a slot is retired after it, so a generation never wraps
+
 Simulation::Simulation() {
     // cout some info about omp version
     std::cout << "OpenMP version: " << _OPENMP << std::endl; // _OPENMP is defined by g++, not msvc
@@ -26,18 +37,174 @@ Simulation::Simulation() {
 
     // setup the grid
     grid = std::make_unique<Grid>(MAX_PARTICLE_RADIUS * 2.0f); // the grid cell size is 2 times the max particle radius
+    octree = std::make_unique<Octree>();
+    particleMesh = std::make_unique<ParticleMesh>();
 }
 
 int Simulation::getNumParticles() {
     return num_particles;
 }
 
-void Simulation::step(float dt) {
-    for (auto& p : particles) {
+// add the accelerations of the fields to the particles [first, last[ and integrate them
+template <typename ParticleType>
+static void integrateBatch(const std::vector<std::shared_ptr<ParticleType>>& ps, int first, int last, const std::vector<const ForceField*>& fields, FieldBatch& batch, float dt) {
+    const int n = last - first;
+    if (!fields.empty()) {
+        batch.resize(n);
+        for (int i = 0; i < n; i++) {
+            const Particle* p = ps[first + i].get();
+            // with Verlet integration the velocity is the displacement since the previous position
+            glm::vec3 v = (p->position - p->previous_position) / dt;
+            batch.x[i] = p->position.x; batch.y[i] = p->position.y; batch.z[i] = p->position.z;
+            batch.vx[i] = v.x; batch.vy[i] = v.y; batch.vz[i] = v.z;
+            batch.ax[i] = 0.0f; batch.ay[i] = 0.0f; batch.az[i] = 0.0f;
+        }
+        for (const ForceField* field : fields) {
+            field->apply(batch, n);
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        Particle* p = ps[first + i].get();
+        if (!fields.empty()) {
+            p->addForce(glm::vec3(batch.ax[i], batch.ay[i], batch.az[i]));
+        }
         p->updatePosition(dt);
     }
 }
 
+RayHit Simulation::raycast(const Ray& ray, float maxDistance) const {
+    // the grid skips the spheres removed since it was built, the ones added since then are tested one by one
+    RayHit hit = grid->raycast(ray, maxDistance);
+    Ray unitRay(ray.origin, glm::normalize(ray.direction));
+    for (size_t i = griddedSpheres; i < spheres.size(); i++) {
+        const auto& sphere = spheres[i];
+        float distance = unitRay.intersect(*sphere);
+        if (distance >= 0.0f && distance < hit.distance && distance <= maxDistance) {
+            hit.sphere = sphere;
+            hit.distance = distance;
+        }
+    }
+    return hit;
+}
+
+std::vector<RayHit> Simulation::raycast(const std::vector<Ray>& rays, float maxDistance) const {
+    std::vector<RayHit> hits(rays.size());
+    const int numRays = static_cast<int>(rays.size());
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (int i = 0; i < numRays; i++) {
+        hits[i] = raycast(rays[i], maxDistance);
+    }
+    return hits;
+}
+
+void Simulation::publishFrame() {
+    frameDisplacement = 0.0f;
+    frameDisplacementValid = true;
+    const int numParticles = static_cast<int>(particles.size());
+    #pragma omp parallel for
+    for (int i = 0; i < numParticles; i++) {
+        particles[i]->frame_position = particles[i]->position;
+    }
+}
+
+float Simulation::getFrameDisplacement() {
+    if (!frameDisplacementValid) {
+        float maxDistance2 = 0.0f;
+        const int numSpheres = static_cast<int>(spheres.size());
+        #pragma omp parallel for reduction(max: maxDistance2)
+        for (int i = 0; i < numSpheres; i++) {
+            glm::vec3 d = spheres[i]->position - spheres[i]->frame_position;
+            maxDistance2 = std::max(maxDistance2, glm::dot(d, d));
+        }
+        frameDisplacement = std::sqrt(maxDistance2);
+        frameDisplacementValid = true;
+    }
+    return frameDisplacement;
+}
+
+void Simulation::prepareIntegration(IntegrationPlan& plan) {
+    for (auto& field : forceFields) {
+        if (field->enabled) {
+            plan.fields.push_back(field.get());
+        }
+    }
+    if (!gridUpToDate) {
+        return;
+    }
+    for (auto& entry : grid->grid) {
+        plan.keys.push_back(entry.first);
+        plan.cells.push_back(&entry.second);
+    }
+    plan.fieldMin.resize(plan.fields.size());
+    plan.fieldMax.resize(plan.fields.size());
+    for (size_t f = 0; f < plan.fields.size(); f++) {
+        plan.fields[f]->getBounds(plan.fieldMin[f], plan.fieldMax[f]);
+    }
+}
+
+void Simulation::integrateCells(const IntegrationPlan& plan, int first, int last, FieldBatch& batch, std::vector<const ForceField*>& cellFields, float dt) {
+    const float margin = grid->getCellSize(); // the spheres may have left their cell since the grid was built
+    for (int c = first; c < last; c++) {
+        glm::vec3 cellMin, cellMax;
+        grid->getCellBounds(plan.keys[c], cellMin, cellMax);
+        cellFields.clear();
+        for (size_t f = 0; f < plan.fields.size(); f++) {
+            if (!plan.fields[f]->isBounded() || (glm::all(glm::lessThanEqual(cellMin - margin, plan.fieldMax[f])) && glm::all(glm::greaterThanEqual(cellMax + margin, plan.fieldMin[f])))) {
+                cellFields.push_back(plan.fields[f]);
+            }
+        }
+        integrateBatch(*plan.cells[c], 0, static_cast<int>(plan.cells[c]->size()), cellFields, batch, dt);
+    }
+}
+
+void Simulation::step(float dt) {
+    applyLongRangeForces();
+
+    // * force fields and integration in a single pass
+    IntegrationPlan plan;
+    prepareIntegration(plan);
+    if (gridUpToDate) {
+        // per cell of the grid, so the fields with a bounded support are only evaluated in the cells they reach
+        const int numCells = static_cast<int>(plan.cells.size());
+        #pragma omp parallel
+        {
+            FieldBatch batch;
+            std::vector<const ForceField*> cellFields;
+            #pragma omp for schedule(dynamic, 16)
+            for (int c = 0; c < numCells; c++) {
+                integrateCells(plan, c, c + 1, batch, cellFields, dt);
+            }
+        }
+    } else {
+        // the grid is out of date (spheres were added since the last collision check), every field is evaluated
+        const int numParticles = static_cast<int>(particles.size());
+        const int batchSize = 256;
+        #pragma omp parallel
+        {
+            FieldBatch batch;
+            #pragma omp for schedule(static)
+            for (int first = 0; first < numParticles; first += batchSize) {
+                integrateBatch(particles, first, std::min(first + batchSize, numParticles), plan.fields, batch, dt);
+            }
+        }
+    }
+
+    finishStep(dt);
+}
+
+void Simulation::finishStep(float dt) {
+    // * move the kinematic containers, the next collision pass sweeps their walls from the previous pose
+    time += dt;
+    for (auto& container : containers) {
+        container->updateMotion(time);
+    }
+
+    // * sinks and emitters, the particle lists only change here
+    applySinks();
+    compactParticles();
+    applyEmitters(dt);
+}
+
 void Simulation::checkCollisions() { // regular collision check without grid
     const int num_particles = static_cast<int>(spheres.size());
     #pragma omp parallel for schedule(static, 1)
@@ -47,9 +214,9 @@ void Simulation::checkCollisions() { // regular collision check without grid
             spheres[i]->collideWith(spheres[j]);
         }
         // * collision with planes
-        // for (auto& plane : planes) {
-        //     particles[i]->collideWith(plane);
-        // }
+        for (auto& plane : planes) {
+            spheres[i]->collideWith(plane);
+        }
         // * collision with containers
         for (auto& container : containers) {
             particles[i]->collideWith(container);
@@ -78,6 +245,106 @@ void Simulation::checkCollisions() { // regular collision check without grid
 //         }
 // }
 
+// whether the spheres of a cell can touch the container, from its rasterization (null for a kinematic container) or from its current pose
+template <typename ContainerType>
+static bool isCellNearContainer(ContainerType* container, const ContainerRaster* raster, Grid& grid, glm::ivec3 cell) {
+    if (raster != nullptr) {
+        return raster->isNearBoundary(cell);
+    }
+    // a moving container changes every substep, so only the occupied cells are tested instead of rasterizing it again
+    // the margin grows with the motion of the walls, a wall that moved several cells still finds the spheres it swept past
+    glm::vec3 cellMin, cellMax;
+    grid.getCellBounds(cell, cellMin, cellMax);
+    float margin = grid.getCellSize() + container->getMaxWallDisplacement(cellMin, cellMax);
+    return container->ContainerType::isNearBoundary(cellMin, cellMax, margin);
+}
+
+// collide the spheres of the boundary cells with all the containers of one type
+// the containers are solved one after the other since they can share spheres, the spheres of a batch in parallel
+template <typename ContainerType>
+static void collideContainers(std::vector<std::shared_ptr<Container>>& typedContainers, Grid& grid, std::vector<std::pair<glm::ivec3, std::vector<std::shared_ptr<Sphere>>>>& cells) {
+    std::vector<Sphere*> batch;
+    for (auto& c : typedContainers) {
+        ContainerType* container = static_cast<ContainerType*>(c.get());
+        const ContainerRaster* raster = container->isKinematic() ? nullptr : &grid.getContainerRaster(*container);
+        batch.clear();
+        for (auto& cell : cells) {
+            if (isCellNearContainer(container, raster, grid, cell.first)) {
+                for (auto& s : cell.second) {
+                    batch.push_back(s.get());
+                }
+            }
+        }
+        container->ContainerType::collideWith(batch);
+    }
+}
+
+// whether the spheres of a cell can touch any container of one type (rasters holds the static ones)
+template <typename ContainerType>
+static bool isCellNearContainers(std::vector<std::shared_ptr<Container>>& typedContainers, const std::unordered_map<const Container*, const ContainerRaster*>& rasters, Grid& grid, glm::ivec3 cell) {
+    for (auto& c : typedContainers) {
+        ContainerType* container = static_cast<ContainerType*>(c.get());
+        auto it = rasters.find(container);
+        if (isCellNearContainer(container, it != rasters.end() ? it->second : nullptr, grid, cell)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// same as collideContainers in the task graph: every container is a group of chunks of cells waiting for the previous container
+template <typename ContainerType>
+static TaskGraph::TaskId addContainerTasks(TaskGraph& graph, std::vector<std::shared_ptr<Container>>& typedContainers, const std::unordered_map<const Container*, const ContainerRaster*>& rasters,
+                                           Grid& grid, std::vector<std::pair<glm::ivec3, std::vector<std::shared_ptr<Sphere>>>>& cells, int numChunks, TaskGraph::TaskId previous) {
+    for (auto& c : typedContainers) {
+        ContainerType* container = static_cast<ContainerType*>(c.get());
+        previous = graph.addParallel(numChunks, [container, &rasters, &grid, &cells, numChunks](int chunk) {
+            auto it = rasters.find(container);
+            const ContainerRaster* raster = it != rasters.end() ? it->second : nullptr;
+            size_t first = cells.size() * chunk / numChunks;
+            size_t last = cells.size() * (chunk + 1) / numChunks;
+            for (size_t i = first; i < last; i++) {
+                if (isCellNearContainer(container, raster, grid, cells[i].first)) {
+                    for (auto& s : cells[i].second) {
+                        container->ContainerType::collideWith(s.get()); // qualified call, no virtual dispatch
+                    }
+                }
+            }
+        }, {previous});
+    }
+    return previous;
+}
+
+void Simulation::collideCell(std::pair<glm::ivec3, std::vector<std::shared_ptr<Sphere>>>& cell, ContactBatch& batch, std::vector<int>& triangles) {
+    std::vector<std::shared_ptr<Sphere>> neighbors = grid->getNeighbors(cell.first);
+    batch.gather(neighbors);
+    for (auto& s : cell.second) {
+        solveContacts(*s, batch);
+        scatterContacts(batch);
+    }
+
+    // * collision with the static geometry
+    if (!meshColliders.empty()) {
+        glm::vec3 cellMin, cellMax;
+        grid->getCellBounds(cell.first, cellMin, cellMax);
+        for (auto& collider : meshColliders) {
+            collider->collideWith(cell.second, cellMin, cellMax, triangles);
+        }
+    }
+    for (auto& plane : planes) {
+        for (auto& s : cell.second) {
+            s->collideWith(plane);
+        }
+    }
+}
+
+void Simulation::collideAllContainers(std::vector<std::pair<glm::ivec3, std::vector<std::shared_ptr<Sphere>>>>& cells) {
+    // * collision with containers, only for the spheres of the cells near a wall
+    collideContainers<CubeContainer>(cubeContainers, *grid, cells);
+    collideContainers<SphereContainer>(sphereContainers, *grid, cells);
+    collideContainers<MeshContainer>(meshContainers, *grid, cells);
+}
+
 // ? method 2 : iterate over the grid
 void Simulation::checkGridCollisions() {
     // clear the grid
@@ -85,22 +352,187 @@ void Simulation::checkGridCollisions() {
     for (auto& s: spheres) {
         grid->insert(s);
     }
+    gridUpToDate = true;
+    griddedSpheres = spheres.size();
     std::vector<std::pair<glm::ivec3, std::vector<std::shared_ptr<Sphere>>>> gridAsVector(grid->grid.begin(), grid->grid.end());
     const int num_cells = static_cast<int>(gridAsVector.size());
-    #pragma omp parallel for schedule(static, 1)
-    for (int i = 0; i < num_cells; ++i) {
-        std::vector<std::shared_ptr<Sphere>> neighbors = grid->getNeighbors(gridAsVector[i].first);
-        for (auto& s : gridAsVector[i].second) {
-            for (auto& neighbor : neighbors) {
-                if (s != neighbor) {
-                    s->collideWith(neighbor);
+    #pragma omp parallel
+    {
+        ContactBatch batch; // reused by the thread for all its cells
+        std::vector<int> triangles; // candidate triangles of the mesh colliders for the current cell
+        #pragma omp for schedule(static, 1)
+        for (int i = 0; i < num_cells; ++i) {
+            collideCell(gridAsVector[i], batch, triangles);
+        }
+    }
+
+    collideAllContainers(gridAsVector);
+}
+
+void Simulation::substep(float dt) {
+    frameDisplacementValid = false;
+    if (!scheduler) {
+        checkGridCollisions();
+        maintainMolecules();
+        solveFluids();
+        step(dt);
+        return;
+    }
+    substepTasks(dt);
+}
+
+void Simulation::enableTaskScheduler() {
+    scheduler = std::make_unique<TaskScheduler>(omp_get_max_threads());
+    std::cout << "Task scheduler: " << scheduler->getNumThreads() << " threads" << std::endl;
+}
+
+// split a list of costs in numChunks ranges of about the same total cost, bounds gets numChunks + 1 indices
+static void splitByCost(const std::vector<float>& costs, int numChunks, std::vector<int>& bounds) {
+    float total = 0.0f;
+    for (float cost : costs) {
+        total += cost;
+    }
+    bounds.assign(numChunks + 1, static_cast<int>(costs.size()));
+    bounds[0] = 0;
+    float sum = 0.0f;
+    int chunk = 1;
+    for (int i = 0; i < static_cast<int>(costs.size()) && chunk < numChunks; i++) {
+        sum += costs[i];
+        while (chunk < numChunks && sum >= total * chunk / numChunks) {
+            bounds[chunk++] = i + 1;
+        }
+    }
+}
+
+void Simulation::substepTasks(float dt) {
+    // * one substep as a graph of tasks, in the order of substep without the scheduler: the grid, the contacts in chunks of even cost,
+    // the containers in chunks of cells, the molecules (overlapping the containers when they are away from them), the fluids and the integration
+    const int numThreads = scheduler->getNumThreads();
+    const int numChunks = numThreads * TASK_CHUNKS_PER_THREAD;
+
+    // filled by the tasks that run first, read by the next ones
+    std::vector<std::pair<glm::ivec3, std::vector<std::shared_ptr<Sphere>>>> cells;
+    std::vector<int> contactBounds, integrationBounds;
+    IntegrationPlan plan;
+
+    // scratch data of every thread
+    std::vector<ContactBatch> contactBatches(numThreads);
+    std::vector<std::vector<int>> triangles(numThreads);
+    std::vector<FieldBatch> fieldBatches(numThreads);
+    std::vector<std::vector<const ForceField*>> cellFields(numThreads);
+
+    // the static containers are rasterized (with OpenMP, when they changed) before the tasks run, so they don't compete with the workers
+    std::unordered_map<const Container*, const ContainerRaster*> rasters;
+    for (auto* typedContainers : {&cubeContainers, &sphereContainers, &meshContainers}) {
+        for (auto& c : *typedContainers) {
+            if (!c->isKinematic()) {
+                rasters[c.get()] = &grid->getContainerRaster(*c);
+            }
+        }
+    }
+
+    TaskGraph graph;
+
+    TaskGraph::TaskId gridTask = graph.add([&] {
+        grid->clear();
+        for (auto& s : spheres) {
+            grid->insert(s);
+        }
+        gridUpToDate = true;
+        griddedSpheres = spheres.size();
+        cells.assign(grid->grid.begin(), grid->grid.end());
+
+        // the cost of a cell is the number of pairs it tests, so that a crowded cell weighs more than many sparse ones
+        std::vector<float> costs(cells.size());
+        for (size_t i = 0; i < cells.size(); i++) {
+            size_t neighbors = 0;
+            for (int x = -1; x <= 1; ++x) {
+                for (int y = -1; y <= 1; ++y) {
+                    for (int z = -1; z <= 1; ++z) {
+                        const std::vector<std::shared_ptr<Sphere>>* content = grid->getCellContent(cells[i].first + glm::ivec3(x, y, z));
+                        neighbors += content != nullptr ? content->size() : 0;
+                    }
                 }
             }
-            for (auto& container : containers) {
-                s->collideWith(container);
+            costs[i] = static_cast<float>(cells[i].second.size() * neighbors + 1);
+        }
+        splitByCost(costs, numChunks, contactBounds);
+    });
+
+    TaskGraph::TaskId contactTask = graph.addParallel(numChunks, [&](int chunk) {
+        int thread = TaskScheduler::getThreadIndex();
+        for (int k = contactBounds[chunk]; k < contactBounds[chunk + 1]; k++) {
+            collideCell(cells[k], contactBatches[thread], triangles[thread]);
+        }
+    }, {gridTask});
+
+    // * the containers one after the other since they can share spheres, each in chunks of cells
+    TaskGraph::TaskId containerTask = contactTask;
+    containerTask = addContainerTasks<CubeContainer>(graph, cubeContainers, rasters, *grid, cells, numChunks, containerTask);
+    containerTask = addContainerTasks<SphereContainer>(graph, sphereContainers, rasters, *grid, cells, numChunks, containerTask);
+    containerTask = addContainerTasks<MeshContainer>(graph, meshContainers, rasters, *grid, cells, numChunks, containerTask);
+
+    // * the molecules are independent, the links of a color share no sphere and are solved in parallel, one color after the other
+    // a molecule with no sphere in a cell near a container isn't touched by the container pass, it only waits for the contacts and overlaps the containers
+    // (the positions and the container poses don't change between here and the grid task)
+    std::vector<TaskGraph::TaskId> beforeForces = {containerTask};
+    for (auto& m : molecules) {
+        Molecule* molecule = m.get();
+        bool nearContainer = false;
+        for (auto& sphere : molecule->spheres) {
+            glm::ivec3 cell = grid->getCell(sphere->position);
+            if (isCellNearContainers<CubeContainer>(cubeContainers, rasters, *grid, cell) || isCellNearContainers<SphereContainer>(sphereContainers, rasters, *grid, cell)
+                || isCellNearContainers<MeshContainer>(meshContainers, rasters, *grid, cell)) {
+                nearContainer = true;
+                break;
             }
         }
+        TaskGraph::TaskId previous = nearContainer ? containerTask : contactTask;
+        if (molecule->linksEnabled) {
+            for (const std::vector<size_t>& color : molecule->getLinkColors()) {
+                const std::vector<size_t>* links = &color;
+                int numLinkChunks = static_cast<int>((color.size() + LINK_CHUNK_SIZE - 1) / LINK_CHUNK_SIZE);
+                previous = graph.addParallel(numLinkChunks, [molecule, links](int chunk) {
+                    size_t last = std::min(links->size(), static_cast<size_t>(chunk + 1) * LINK_CHUNK_SIZE);
+                    for (size_t k = static_cast<size_t>(chunk) * LINK_CHUNK_SIZE; k < last; k++) {
+                        auto& link = molecule->links[(*links)[k]];
+                        molecule->maintainDistance(link.first, link.second);
+                    }
+                }, {previous});
+            }
+        }
+        if (!molecule->linksEnabled || molecule->useInternalPressure) {
+            previous = graph.add([molecule] {
+                if (!molecule->linksEnabled) {
+                    molecule->maintainDistanceAll();
+                }
+                if (molecule->useInternalPressure) {
+                    molecule->addInternalPressure();
+                }
+            }, {previous});
+        }
+        beforeForces.push_back(previous);
     }
+
+    // the fluids and the long range forces use OpenMP, they run on the thread owning the OpenMP pool
+    TaskGraph::TaskId forceTask = graph.add([&] {
+        solveFluids();
+        applyLongRangeForces();
+        prepareIntegration(plan);
+        std::vector<float> costs(plan.cells.size());
+        for (size_t c = 0; c < plan.cells.size(); c++) {
+            costs[c] = static_cast<float>(plan.cells[c]->size() + 1);
+        }
+        splitByCost(costs, numChunks, integrationBounds);
+    }, beforeForces, true);
+
+    graph.addParallel(numChunks, [&](int chunk) {
+        int thread = TaskScheduler::getThreadIndex();
+        integrateCells(plan, integrationBounds[chunk], integrationBounds[chunk + 1], fieldBatches[thread], cellFields[thread], dt);
+    }, {forceTask});
+
+    scheduler->run(graph);
+    finishStep(dt);
 }
 
 void Simulation::addForce(glm::vec3 force) {
@@ -109,15 +541,55 @@ void Simulation::addForce(glm::vec3 force) {
     }
 }
 
+std::shared_ptr<ForceField> Simulation::createForceField(ForceField::Type type) {
+    auto field = std::make_shared<ForceField>(type);
+    forceFields.push_back(field);
+    return field;
+}
+
+void Simulation::applyLongRangeForces() {
+    if (!longRange.enabled) {
+        return;
+    }
+    if (longRange.method == LongRangeForce::PARTICLE_MESH && !containers.empty()) {
+        // the mesh covers the containers
+        glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+        for (auto& container : containers) {
+            glm::vec3 containerMin, containerMax;
+            container->getBounds(containerMin, containerMax);
+            min = glm::min(min, containerMin);
+            max = glm::max(max, containerMax);
+        }
+        particleMesh->solve(particles, min, max, longRange);
+        return;
+    }
+    // Barnes-Hut : O(n log n) instead of testing every pair (also used when there is no container to put the mesh on)
+    octree->build(particles, longRange.interaction);
+    octree->applyForces(longRange);
+}
+
 void Simulation::createCubeContainer(glm::vec3 position, glm::vec3 size, bool fordedInside) {
     auto cc = std::make_shared<CubeContainer>(position, size, fordedInside);
     containers.push_back(cc);
+    cubeContainers.push_back(cc);
 }
 
 void Simulation::createSphereContainer(glm::vec3 position, float radius, bool fordedInside) {
     glm::vec3 size = glm::vec3(radius * 2.0f);
     auto sc = std::make_shared<SphereContainer>(position, size, fordedInside);
     containers.push_back(sc);
+    sphereContainers.push_back(sc);
+}
+
+void Simulation::createMeshCollider(glm::vec3 position, std::string path, float scale) {
+    meshColliders.push_back(std::make_shared<MeshCollider>(position, path, scale));
+}
+
+void Simulation::createMeshContainer(glm::vec3 position, std::string path, int resolution, float scale, bool fordedInside) {
+    auto mc = std::make_shared<MeshContainer>(position, path, resolution, scale, fordedInside);
+    containers.push_back(mc);
+    meshContainers.push_back(mc);
 }
 
 void Simulation::maintainMolecules() {
@@ -133,14 +605,35 @@ void Simulation::maintainMolecules() {
     }
 }
 
-std::shared_ptr<Sphere> Simulation::createSphere(std::shared_ptr<Sphere> sphere) {
+void Simulation::solveFluids() {
+    for (auto& f : fluids) {
+        f->solve(*grid);
+    }
+}
+
+std::shared_ptr<Sphere> Simulation::registerSphere(std::shared_ptr<Sphere> sphere) {
+    unsigned int slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.front();
+        freeSlots.pop_front();
+    } else {
+        slot = static_cast<unsigned int>(idToIndex.size()); // the slots run out with the memory long before the 32 bits of the field
+        idToIndex.push_back(-1);
+        slotGenerations.push_back(0);
+    }
+    sphere->id = slot | (static_cast<uint64_t>(slotGenerations[slot]) << ID_SLOT_BITS);
+    idToIndex[slot] = static_cast<int>(particles.size());
     particles.push_back(sphere);
     spheres.push_back(sphere);
     this->num_particles++;
-
+    gridUpToDate = false;
     return sphere;
 }
 
+std::shared_ptr<Sphere> Simulation::createSphere(std::shared_ptr<Sphere> sphere) {
+    return registerSphere(sphere);
+}
+
 std::shared_ptr<Sphere> Simulation ::createSphere(glm::vec3 position, float radius, glm::vec3 velocity, glm::vec3 acceleration, bool fixed) {
     auto p = std::make_shared<Sphere>();
     p->position = position;
@@ -149,10 +642,105 @@ std::shared_ptr<Sphere> Simulation ::createSphere(glm::vec3 position, float radi
     p->acceleration = acceleration;
     p->radius = radius;
     p->fixed = fixed;
-    particles.push_back(p);
-    spheres.push_back(p);
-    this->num_particles++;
-    return p;
+    return registerSphere(p);
+}
+
+std::shared_ptr<Particle> Simulation::getParticle(uint64_t id) {
+    uint64_t slot = id & ID_SLOT_MASK;
+    // an id of a removed particle has an older generation than its slot
+    if (slot >= idToIndex.size() || idToIndex[slot] < 0 || slotGenerations[slot] != id >> ID_SLOT_BITS) {
+        return nullptr;
+    }
+    return particles[idToIndex[slot]];
+}
+
+void Simulation::removeParticle(uint64_t id) {
+    std::shared_ptr<Particle> particle = getParticle(id);
+    if (particle == nullptr || particle->removed) {
+        return;
+    }
+    particle->removed = true;
+    pendingRemovals.push_back(id);
+}
+
+void Simulation::applySinks() {
+    if (sinks.empty()) {
+        return;
+    }
+    const int numParticles = static_cast<int>(particles.size());
+    #pragma omp parallel
+    {
+        std::vector<uint64_t> found; // merged once per thread
+        #pragma omp for schedule(static)
+        for (int i = 0; i < numParticles; i++) {
+            Particle* p = particles[i].get();
+            if (p->removed) {
+                continue;
+            }
+            for (auto& sink : sinks) {
+                if (sink->enabled && sink->contains(p->position)) {
+                    p->removed = true;
+                    found.push_back(p->id);
+                    break;
+                }
+            }
+        }
+        #pragma omp critical
+        pendingRemovals.insert(pendingRemovals.end(), found.begin(), found.end());
+    }
+}
+
+void Simulation::compactParticles() {
+    if (pendingRemovals.empty()) {
+        return;
+    }
+    // swap with the last particle, so only the moved particle changes index (the ids don't change)
+    auto move = [this](int from, int to) {
+        particles[to] = particles[from];
+        spheres[to] = spheres[from];
+        idToIndex[particles[to]->id & ID_SLOT_MASK] = to;
+    };
+    for (uint64_t id : pendingRemovals) {
+        size_t slot = id & ID_SLOT_MASK;
+        int index = idToIndex[slot];
+        // the spheres of the grid stay in front of the ones added since it was built, the last of them fills the hole first
+        if (index < static_cast<int>(griddedSpheres)) {
+            move(static_cast<int>(griddedSpheres) - 1, index);
+            index = static_cast<int>(--griddedSpheres);
+        }
+        int last = static_cast<int>(particles.size()) - 1;
+        if (index != last) {
+            move(last, index);
+        }
+        particles.pop_back();
+        spheres.pop_back();
+        idToIndex[slot] = -1;
+        // a slot whose generations are used up is retired, an old id could otherwise match again
+        if (slotGenerations[slot] < ID_LAST_GENERATION) {
+            slotGenerations[slot]++;
+            freeSlots.push_back(static_cast<unsigned int>(slot));
+        }
+        this->num_particles--;
+    }
+    pendingRemovals.clear();
+    gridUpToDate = false;
+
+    // the groups holding the removed spheres, the empty ones are dropped
+    molecules.erase(std::remove_if(molecules.begin(), molecules.end(), [](const std::shared_ptr<Molecule>& m) {
+        return m->removeMarkedSpheres();
+    }), molecules.end());
+    fluids.erase(std::remove_if(fluids.begin(), fluids.end(), [](const std::shared_ptr<Fluid>& f) {
+        return f->removeMarkedSpheres();
+    }), fluids.end());
+}
+
+void Simulation::applyEmitters(float dt) {
+    for (auto& emitter : emitters) {
+        int count = emitter->getEmitCount(dt);
+        for (int i = 0; i < count; i++) {
+            registerSphere(emitter->emit(dt));
+        }
+    }
 }
 
 std::shared_ptr<Molecule> Simulation::loadMolecule(std::string filename, glm::vec3 offset) {
@@ -168,6 +756,9 @@ std::shared_ptr<Molecule> Simulation::loadMolecule(std::string filename, glm::ve
         useInternalPressure = true;
     }
     std::shared_ptr<Molecule> molecule = std::make_shared<Molecule>(j["distance"], j["linksEnabled"], j["strength"], internalPressure, useInternalPressure);
+    if (j.find("skipLinkedCollisions") != j.end()) {
+        molecule->setSkipLinkedCollisions(j["skipLinkedCollisions"]);
+    }
 
     // Create a vector to store the spheres
     std::vector<std::shared_ptr<Sphere>> spheres;
@@ -208,6 +799,11 @@ std::shared_ptr<Molecule> Simulation::loadMolecule(std::string filename, glm::ve
             acceleration,
             fixed
         );
+        if (jSphere.find("mass") != jSphere.end()) {
+            sphere->setMass(jSphere["mass"]);
+        }
+        parseCollisionFilter(j, sphere.get());
+        parseCollisionFilter(jSphere, sphere.get());
 
         // Add the sphere to the molecule and the spheres vector
         molecule->addSphere(sphere);
@@ -233,6 +829,11 @@ void Simulation::loadWorld(std::string filename) {
 
     file >> j;
 
+    // Load the settings of the world
+    if (j.find("longRange") != j.end()) {
+        this->longRange = parseLongRange(j["longRange"]);
+    }
+
     // Load the containers
     for (const auto& jContainer : j["containers"]) {
         std::shared_ptr<Container> container = parseContainer(jContainer);
@@ -242,10 +843,26 @@ void Simulation::loadWorld(std::string filename) {
                 this->cubeContainers.push_back(std::dynamic_pointer_cast<CubeContainer>(container));
             } else if (std::dynamic_pointer_cast<SphereContainer>(container) != nullptr) {
                 this->sphereContainers.push_back(std::dynamic_pointer_cast<SphereContainer>(container));
+            } else if (std::dynamic_pointer_cast<MeshContainer>(container) != nullptr) {
+                this->meshContainers.push_back(std::dynamic_pointer_cast<MeshContainer>(container));
             }
         }
     }
 
+    // Load the static geometry
+    for (const auto& jCollider : j["colliders"]) {
+        std::shared_ptr<MeshCollider> collider = parseCollider(jCollider);
+        if (collider != nullptr) {
+            this->meshColliders.push_back(collider);
+        }
+    }
+    for (const auto& jPlane : j["planes"]) {
+        std::shared_ptr<Plane> plane = parsePlane(jPlane);
+        if (plane != nullptr) {
+            this->planes.push_back(plane);
+        }
+    }
+
     // Load the spheres
     for (const auto& jSphere : j["spheres"]) {
         std::shared_ptr<Sphere> sphere = parseSphere(jSphere);
@@ -264,4 +881,37 @@ void Simulation::loadWorld(std::string filename) {
             this->molecules.push_back(molecule);
         }
     }
+
+    // Load the force fields
+    for (const auto& jField : j["forceFields"]) {
+        std::shared_ptr<ForceField> field = parseForceField(jField);
+        if (field != nullptr) {
+            this->forceFields.push_back(field);
+        }
+    }
+
+    // Load the emitters and the sinks
+    for (const auto& jEmitter : j["emitters"]) {
+        std::shared_ptr<Emitter> emitter = parseEmitter(jEmitter);
+        if (emitter != nullptr) {
+            this->emitters.push_back(emitter);
+        }
+    }
+    for (const auto& jSink : j["sinks"]) {
+        std::shared_ptr<Sink> sink = parseSink(jSink);
+        if (sink != nullptr) {
+            this->sinks.push_back(sink);
+        }
+    }
+
+    // Load the fluids
+    for (const auto& jFluid : j["fluids"]) {
+        std::shared_ptr<Fluid> fluid = parseFluid(jFluid);
+        if (fluid != nullptr) {
+            for (auto& s : fluid->spheres) {
+                this->createSphere(s);
+            }
+            this->fluids.push_back(fluid);
+        }
+    }
 }
\ No newline at end of file
@@ -2,19 +2,67 @@
 
 #include <vector>
 #include <memory>
+#include <deque>
 #include "particle.hpp"
 #include "plane.hpp"
 #include "container.hpp"
 #include "grid.hpp"
 #include "molecule.hpp"
+#include "fluid.hpp"
+#include "forceField.hpp"
+#include "emitter.hpp"
+#include "sink.hpp"
+#include "meshCollider.hpp"
+#include "octree.hpp"
+#include "particleMesh.hpp"
+#include "longRangeForce.hpp"
+#include "taskScheduler.hpp"
+#include "../utils/ray.hpp"
+#include "../config.hpp"
+
+struct ContactBatch;
 
 class Simulation {
 private: 
     int num_particles = 0;
     int num_threads = 4;
+    float time = 0.0f; // simulated time, drives the kinematic containers
+    bool gridUpToDate = false; // whether the grid holds exactly the spheres (no sphere was added or removed since the last collision check)
+    size_t griddedSpheres = 0; // the first spheres of the list are in the grid, the next ones were added since it was built
+    float frameDisplacement = 0.0f; // largest distance moved by a sphere since publishFrame, measured on demand
+    bool frameDisplacementValid = true;
+    // an id is a slot and the generation of the slot, so the id of a removed particle never gives another one
+    std::vector<int> idToIndex; // index in particles of every slot, -1 for a free slot
+    std::vector<unsigned int> slotGenerations; // generation of the particle in every slot, incremented when it is removed
+    std::deque<unsigned int> freeSlots; // slots of the removed particles, reused oldest first so the table doesn't grow
+    std::vector<uint64_t> pendingRemovals; // ids of the particles to remove at the end of the step
+
+    std::shared_ptr<Sphere> registerSphere(std::shared_ptr<Sphere> sphere); // give an id to a new sphere and add it to the lists
+    void applySinks(); // mark the spheres inside the sinks for removal
+    void compactParticles(); // remove the marked particles from all the lists
+    void applyEmitters(float dt);
+
+    std::unique_ptr<TaskScheduler> scheduler; // null: the substeps run as OpenMP loops
+
+    // fields active during the step and, with an up to date grid, the cells to integrate
+    struct IntegrationPlan {
+        std::vector<const ForceField*> fields;
+        std::vector<glm::vec3> fieldMin, fieldMax;
+        std::vector<const std::vector<std::shared_ptr<Sphere>>*> cells;
+        std::vector<glm::ivec3> keys;
+    };
+    void prepareIntegration(IntegrationPlan& plan);
+    void integrateCells(const IntegrationPlan& plan, int first, int last, FieldBatch& batch, std::vector<const ForceField*>& cellFields, float dt); // cells [first, last[ of the plan
+    void collideCell(std::pair<glm::ivec3, std::vector<std::shared_ptr<Sphere>>>& cell, ContactBatch& batch, std::vector<int>& triangles); // contacts, mesh colliders and planes of the spheres of a cell
+    void collideAllContainers(std::vector<std::pair<glm::ivec3, std::vector<std::shared_ptr<Sphere>>>>& cells);
+    void finishStep(float dt); // kinematic containers, sinks and emitters
+    void substepTasks(float dt);
 
 public:
     std::unique_ptr<Grid> grid; // unique_ptr because only the simulation class should own the grid
+    std::unique_ptr<Octree> octree; // rebuilt every step when the long range force is enabled
+    std::unique_ptr<ParticleMesh> particleMesh; // used instead of the octree with the particle mesh method
+    LongRangeForce longRange;
 
     std::vector<std::shared_ptr<Particle>> particles;
     std::vector<std::shared_ptr<Sphere>> spheres;
@@ -22,19 +70,41 @@ public:
     std::vector<std::shared_ptr<Container>> containers;
     std::vector<std::shared_ptr<Container>> cubeContainers;
     std::vector<std::shared_ptr<Container>> sphereContainers;
+    std::vector<std::shared_ptr<Container>> meshContainers;
     std::vector<std::shared_ptr<Molecule>> molecules;
+    std::vector<std::shared_ptr<Fluid>> fluids;
+    std::vector<std::shared_ptr<ForceField>> forceFields;
+    std::vector<std::shared_ptr<Emitter>> emitters;
+    std::vector<std::shared_ptr<Sink>> sinks;
+    std::vector<std::shared_ptr<MeshCollider>> meshColliders;
 
     Simulation();
 
     int getNumParticles();
-    void step(float dt);  // update simulation by time dt
+    RayHit raycast(const Ray& ray, float maxDistance = CAMERA_FAR) const;  // first sphere along the ray (the grid is walked when it is up to date)
+    std::vector<RayHit> raycast(const std::vector<Ray>& rays, float maxDistance = CAMERA_FAR) const;  // batch of ray queries solved in parallel
+    bool isGridUpToDate() const { return gridUpToDate; } // the grid holds exactly the spheres
+    size_t getGriddedSpheres() const { return griddedSpheres; } // number of leading spheres in the grid (the removed ones stay in it, marked, until it is rebuilt)
+    void publishFrame();  // keep the current positions as the start of the next frame for the render interpolation
+    float getFrameDisplacement();  // largest distance between the position and the frame position of a sphere, bounds how far the drawn spheres are from the grid
+    void substep(float dt);  // collisions, molecules, fluids and step, as a task graph when the task scheduler is enabled
+    void enableTaskScheduler();  // the substeps run on a work stealing scheduler (as many threads as OpenMP) instead of OpenMP loops
+    TaskScheduler* getTaskScheduler() { return scheduler.get(); } // null when not enabled
+    void step(float dt);  // update simulation by time dt (the force fields are applied in the same pass)
     void checkCollisions();  // check for collisions between particles and other elements // old method (doesn't use the grid)
     void checkGridCollisions();  // check for collisions between particles and spheres
     void addForce(glm::vec3 force);  // add force to all particles
+    void applyLongRangeForces();  // add the pairwise long range force (gravity or Coulomb) to all particles
+    std::shared_ptr<ForceField> createForceField(ForceField::Type type);  // add a force field to the simulation
     void createCubeContainer(glm::vec3 position, glm::vec3 size, bool fordedInside = false);  // add a cube container to the simulation
     void createSphereContainer(glm::vec3 position, float radius, bool fordedInside = false);  // add a sphere container to the simulation
+    void createMeshCollider(glm::vec3 position, std::string path, float scale = 1.0f);  // add a static triangle mesh to the simulation
+    void createMeshContainer(glm::vec3 position, std::string path, int resolution = 64, float scale = 1.0f, bool fordedInside = false);  // add a container shaped by an OBJ mesh to the simulation
     void maintainMolecules();  // maintain the distance between the spheres in the molecules
+    void solveFluids();  // keep the density of the fluids (uses the grid of the last collision check)
     std::shared_ptr<Sphere> createSphere(std::shared_ptr<Sphere> sphere);  // add a sphere to the simulation
+    std::shared_ptr<Particle> getParticle(uint64_t id);  // null if there is no particle with this id
+    void removeParticle(uint64_t id);  // the particle is removed at the end of the current step
     std::shared_ptr<Sphere> createSphere(glm::vec3 position, float radius, glm::vec3 velocity, glm::vec3 acceleration, bool fixed = false);  // add a sphere to the simulation
     std::shared_ptr<Molecule> loadMolecule(std::string filename, glm::vec3 offset = glm::vec3(0.0f));  // load a molecule from a json file
     void loadWorld(std::string filename);  // load the world from a json file
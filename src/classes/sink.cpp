@@ -0,0 +1,16 @@
+#include "sink.hpp"
+#include <glm/glm.hpp>
+
+Sink::Sink(glm::vec3 position, glm::vec3 size) {
+    this->shape = BOX;
+    this->position = position;
+    this->size = size;
+    this->radius = 0.0f;
+}
+
+Sink::Sink(glm::vec3 position, float radius) {
+    this->shape = SPHERE;
+    this->position = position;
+    this->size = glm::vec3(radius * 2.0f);
+    this->radius = radius;
+}
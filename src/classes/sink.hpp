@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Volume removing the spheres entering it
+class Sink {
+
+    public:
+        enum Shape {
+            BOX,
+            SPHERE
+        };
+
+        Shape shape;
+        glm::vec3 position;
+        glm::vec3 size; // BOX, full size
+        float radius; // SPHERE
+        bool enabled = true;
+
+        Sink(glm::vec3 position, glm::vec3 size); // box
+        Sink(glm::vec3 position, float radius); // sphere
+        bool contains(glm::vec3 point) const;
+};
+
+inline bool Sink::contains(glm::vec3 point) const {
+    glm::vec3 d = point - position;
+    if (shape == SPHERE) {
+        return glm::dot(d, d) <= radius * radius;
+    }
+    return glm::all(glm::lessThanEqual(glm::abs(d), size / 2.0f));
+}
@@ -0,0 +1,263 @@
+#include "taskScheduler.hpp"
+#include <chrono>
+#include <iomanip>
+#include <algorithm>
+
+static thread_local int currentThreadIndex = 0;
+
+static uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TaskGraph::TaskId TaskGraph::add(std::function<void()> work, const std::vector<TaskId>& dependencies, bool mainThread) {
+    TaskId id = static_cast<TaskId>(tasks.size());
+    tasks.emplace_back();
+    tasks[id].work = std::move(work);
+    tasks[id].mainThread = mainThread;
+    for (TaskId dependency : dependencies) {
+        tasks[dependency].successors.push_back(id);
+        tasks[id].numDependencies++;
+    }
+    return id;
+}
+
+TaskGraph::TaskId TaskGraph::addParallel(int numTasks, std::function<void(int)> work, const std::vector<TaskId>& dependencies) {
+    std::vector<TaskId> parts;
+    parts.reserve(numTasks);
+    auto shared = std::make_shared<std::function<void(int)>>(std::move(work));
+    for (int i = 0; i < numTasks; i++) {
+        parts.push_back(add([shared, i] { (*shared)(i); }, dependencies));
+    }
+    return add(nullptr, parts.empty() ? dependencies : parts);
+}
+
+TaskScheduler::TaskScheduler(int numThreads) {
+    numThreads = std::max(numThreads, 1);
+    for (int i = 0; i < numThreads; i++) {
+        workers.push_back(std::make_unique<Worker>());
+        workers[i]->random = 0x9E3779B97F4A7C15ull * (i + 1);
+    }
+    for (int i = 1; i < numThreads; i++) {
+        threads.emplace_back(&TaskScheduler::workerLoop, this, i);
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+int TaskScheduler::getThreadIndex() {
+    return currentThreadIndex;
+}
+
+void TaskScheduler::run(TaskGraph& graph) {
+    const int numTasks = static_cast<int>(graph.tasks.size());
+    if (numTasks == 0) {
+        return;
+    }
+    uint64_t start = nowNs();
+
+    if (pendingSize < static_cast<size_t>(numTasks)) {
+        pendingSize = numTasks;
+        pending = std::make_unique<std::atomic<int>[]>(pendingSize);
+    }
+    for (int t = 0; t < numTasks; t++) {
+        pending[t].store(graph.tasks[t].numDependencies, std::memory_order_relaxed);
+    }
+    this->graph = &graph;
+    remaining.store(numTasks);
+
+    // the roots are spread over the deques, the threads that don't get one steal
+    int next = 0;
+    for (int t = 0; t < numTasks; t++) {
+        if (graph.tasks[t].numDependencies == 0) {
+            release(next, t);
+            next = (next + 1) % getNumThreads();
+        }
+    }
+
+    while (remaining.load() > 0) {
+        if (runOne(0)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return remaining.load() == 0 || queued.load() > 0 || mainQueued.load() > 0; });
+    }
+
+    this->graph = nullptr;
+    wallNs += nowNs() - start;
+    runs++;
+}
+
+void TaskScheduler::workerLoop(int index) {
+    currentThreadIndex = index;
+    while (true) {
+        if (runOne(index)) {
+            continue;
+        }
+        // ? a short spin before sleeping: the tasks of a substep come in quick waves
+        bool found = false;
+        for (int attempt = 0; attempt < TASK_SPIN_ATTEMPTS && !found; attempt++) {
+            std::this_thread::yield();
+            found = queued.load() > 0 && runOne(index);
+        }
+        if (found) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+bool TaskScheduler::runOne(int index) {
+    int task = -1;
+    if (index == 0 && mainQueued.load() > 0) {
+        std::lock_guard<std::mutex> lock(mainMutex);
+        if (!mainTasks.empty()) {
+            task = mainTasks.front();
+            mainTasks.pop_front();
+            mainQueued--;
+        }
+    }
+    if (task < 0) {
+        Worker& worker = *workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.tasks.empty()) {
+            task = worker.tasks.back();
+            worker.tasks.pop_back();
+            queued--;
+        }
+    }
+    if (task < 0 && !steal(index, task)) {
+        return false;
+    }
+    execute(index, task);
+    return true;
+}
+
+bool TaskScheduler::steal(int index, int& task) {
+    Worker& thief = *workers[index];
+    const int numWorkers = getNumThreads();
+    if (numWorkers == 1 || queued.load() == 0) {
+        return false;
+    }
+    // xorshift, a random first victim so that the thieves don't all hit the same deque
+    thief.random ^= thief.random << 13;
+    thief.random ^= thief.random >> 7;
+    thief.random ^= thief.random << 17;
+    int first = static_cast<int>(thief.random % numWorkers);
+    for (int i = 0; i < numWorkers; i++) {
+        int victimIndex = (first + i) % numWorkers;
+        if (victimIndex == index) {
+            continue;
+        }
+        Worker& victim = *workers[victimIndex];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            queued--;
+            thief.steals++;
+            return true;
+        }
+    }
+    thief.failedSteals++;
+    return false;
+}
+
+void TaskScheduler::execute(int index, int task) {
+    Worker& worker = *workers[index];
+    uint64_t start = nowNs();
+    graph->tasks[task].work();
+    worker.busyNs += nowNs() - start;
+    worker.executed++;
+
+    for (int successor : graph->tasks[task].successors) {
+        if (pending[successor].fetch_sub(1) == 1) {
+            release(index, successor);
+        }
+    }
+    if (remaining.fetch_sub(1) == 1) {
+        notifyAll(); // the calling thread waits for the last task
+    }
+}
+
+void TaskScheduler::release(int index, int task) {
+    const TaskGraph::Task& t = graph->tasks[task];
+    if (!t.work) {
+        // a join completes right away, its successors are released by the same thread
+        for (int successor : t.successors) {
+            if (pending[successor].fetch_sub(1) == 1) {
+                release(index, successor);
+            }
+        }
+        if (remaining.fetch_sub(1) == 1) {
+            notifyAll();
+        }
+        return;
+    }
+    if (t.mainThread) {
+        {
+            std::lock_guard<std::mutex> lock(mainMutex);
+            mainTasks.push_back(task);
+            mainQueued++;
+        }
+        notifyAll();
+        return;
+    }
+    push(index, task);
+}
+
+void TaskScheduler::push(int index, int task) {
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(task);
+        queued++;
+    }
+    // ! the lock orders the push with the check of a thread going to sleep, no wake up is lost
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_one();
+}
+
+void TaskScheduler::notifyAll() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+}
+
+void TaskScheduler::printStats(std::ostream& out) const {
+    out << "Task scheduler: " << getNumThreads() << " threads, " << runs << " graphs, " << std::fixed << std::setprecision(1) << wallNs * 1e-6 << " ms" << std::endl;
+    out << std::setw(8) << "thread" << std::setw(12) << "tasks" << std::setw(10) << "steals" << std::setw(14) << "failed steals" << std::setw(12) << "busy ms" << std::setw(12) << "idle ms" << std::setw(8) << "idle" << std::endl;
+    for (int i = 0; i < getNumThreads(); i++) {
+        const Worker& worker = *workers[i];
+        double busy = worker.busyNs.load() * 1e-6;
+        double idle = std::max(0.0, wallNs * 1e-6 - busy);
+        double idleShare = wallNs > 0 ? 100.0 * idle / (wallNs * 1e-6) : 0.0;
+        out << std::setw(8) << i << std::setw(12) << worker.executed.load() << std::setw(10) << worker.steals.load() << std::setw(14) << worker.failedSteals.load()
+            << std::setw(12) << busy << std::setw(12) << idle << std::setw(7) << idleShare << "%" << std::endl;
+    }
+}
+
+void TaskScheduler::resetStats() {
+    runs = 0;
+    wallNs = 0;
+    for (auto& worker : workers) {
+        worker->executed = 0;
+        worker->steals = 0;
+        worker->failedSteals = 0;
+        worker->busyNs = 0;
+    }
+}
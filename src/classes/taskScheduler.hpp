@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <ostream>
+#include <cstdint>
+
+#define TASK_SPIN_ATTEMPTS 64 // rounds of steal attempts of an idle thread before it sleeps
+
+// * directed acyclic graph of tasks, a task runs once all the tasks it depends on are done
+class TaskGraph {
+public:
+    using TaskId = int;
+
+    // a task without work is a join: it only gathers dependencies
+    TaskId add(std::function<void()> work, const std::vector<TaskId>& dependencies = {}, bool mainThread = false);
+    // numTasks tasks running work(index), returns the join of all of them
+    TaskId addParallel(int numTasks, std::function<void(int)> work, const std::vector<TaskId>& dependencies = {});
+    void clear() { tasks.clear(); }
+    bool isEmpty() const { return tasks.empty(); }
+
+private:
+    friend class TaskScheduler;
+
+    struct Task {
+        std::function<void()> work;
+        std::vector<TaskId> successors;
+        int numDependencies = 0;
+        bool mainThread = false; // only run by the thread calling TaskScheduler::run (for the work using OpenMP)
+    };
+    std::vector<Task> tasks;
+};
+
+// * runs task graphs on a pool of threads, each thread with its own deque of ready tasks
+// a thread takes the last task of its deque (the one it just released, still in its cache)
+// and an idle thread steals the first task of another deque (the oldest, usually the biggest remaining work)
+class TaskScheduler {
+public:
+    TaskScheduler(int numThreads); // including the thread calling run
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    void run(TaskGraph& graph); // returns once all the tasks ran, the calling thread runs tasks too
+    int getNumThreads() const { return static_cast<int>(workers.size()); }
+    static int getThreadIndex(); // index of the current thread in the pool, 0 outside of it (for per thread scratch data)
+
+    void printStats(std::ostream& out) const; // tasks, steals and idle time of every thread since the last reset
+    void resetStats();
+
+private:
+    struct Worker {
+        std::deque<int> tasks;
+        std::mutex mutex;
+        uint64_t random; // state of the victim selection
+
+        std::atomic<uint64_t> executed{0};
+        std::atomic<uint64_t> steals{0};
+        std::atomic<uint64_t> failedSteals{0}; // rounds over all the other deques without finding a task
+        std::atomic<uint64_t> busyNs{0};
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::deque<int> mainTasks;
+    std::mutex mainMutex;
+
+    TaskGraph* graph = nullptr;
+    std::unique_ptr<std::atomic<int>[]> pending; // dependencies left per task
+    size_t pendingSize = 0;
+    std::atomic<int> remaining{0}; // tasks of the graph not done yet
+    std::atomic<int> queued{0}; // tasks in the deques of the workers
+    std::atomic<int> mainQueued{0};
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    uint64_t runs = 0;
+    uint64_t wallNs = 0; // time spent in run, the idle time of a thread is this minus its busy time
+
+    void workerLoop(int index);
+    bool runOne(int index); // run a task of the thread, of the main queue or stolen, false if none was found
+    bool steal(int index, int& task);
+    void execute(int index, int task);
+    void release(int index, int task); // a task whose dependencies are done
+    void push(int index, int task);
+    void notifyAll();
+};
@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 #include <iomanip>
+#include <cstdlib>
+#include <cstdio>
 #include "classes/simulation.hpp"
 
 using namespace std;
@@ -22,14 +24,40 @@ class Cmd {
 
         static Simulation* sim; // pointer to the simulation object
         static string worldFile;
+        static bool halfPrecision; // pack the sphere instances to half floats
+        static string renderer; // how the spheres are drawn: lod, mesh or impostor
+        static int targetFps; // render rate
+        static int simulationRate; // simulation frames per second, independent of the render rate
+        static string headlessDirectory; // offscreen rendering to images in this directory when not empty
+        static int width, height; // resolution of the rendered images
+        static int frameStride; // write one image every frameStride frames
+        static int maxFrames; // number of frames to render in headless mode (0: no limit)
+        static string imageFormat; // png or ppm
+        static bool hotReload; // relink the shader programs when their files change
+        static bool taskScheduler; // run the substeps as a task graph
+        static bool taskStats; // print the statistics of the task scheduler on exit
 
         static void setup(Simulation* sim);
-        static void parse(int argc, char* argv[]);
+        static void parse(int argc, char* argv[]); // read the options, before the OpenGL context is created
+        static void loadWorld(); // load the world file of the options (needs the OpenGL context for the planes)
 
 };
 
 string Cmd::worldFile = "";
 Simulation* Cmd::sim = nullptr;
+bool Cmd::halfPrecision = false;
+string Cmd::renderer = "lod";
+int Cmd::targetFps = 60;
+int Cmd::simulationRate = 60;
+string Cmd::headlessDirectory = "";
+int Cmd::width = 800;
+int Cmd::height = 800;
+int Cmd::frameStride = 1;
+int Cmd::maxFrames = 0;
+string Cmd::imageFormat = "png";
+bool Cmd::hotReload = false;
+bool Cmd::taskScheduler = false;
+bool Cmd::taskStats = false;
 
 void Cmd::printHelp() {
 
@@ -40,10 +68,21 @@ void Cmd::printHelp() {
     cout << left << setw(lineWidth) << "  -h, --help" << "Print this help message" << endl;
     // cout << left << setw(lineWidth) << "  -v, --version" << "Print the version of the program" << endl; // TODO: Implement version later
     cout << left << setw(lineWidth) << "  -w, --world <world_file>" << "Specify the world file to load" << endl;
+    cout << left << setw(lineWidth) << "  -r, --renderer <lod|mesh|impostor>" << "Draw the spheres by level of detail (default), as instanced meshes or as ray cast impostors" << endl;
+    cout << left << setw(lineWidth) << "  --headless <directory>" << "Render offscreen (no window) and write the frames as images in the directory" << endl;
+    cout << left << setw(lineWidth) << "  --resolution <width>x<height>" << "Specify the resolution of the rendered images" << endl;
+    cout << left << setw(lineWidth) << "  --stride <num>" << "Write one image every <num> frames in headless mode" << endl;
+    cout << left << setw(lineWidth) << "  --frames <num>" << "Stop after <num> frames in headless mode" << endl;
+    cout << left << setw(lineWidth) << "  --format <png|ppm>" << "Specify the format of the images" << endl;
+    cout << left << setw(lineWidth) << "  --half" << "Stream the sphere instances in half precision" << endl;
+    cout << left << setw(lineWidth) << "  --hot-reload" << "Relink the shader programs when the files of the shaders directory change" << endl;
+    cout << left << setw(lineWidth) << "  --tasks" << "Run the simulation substeps on the work stealing task scheduler" << endl;
+    cout << left << setw(lineWidth) << "  --task-stats" << "Print the tasks, steals and idle time of every thread on exit (implies --tasks)" << endl;
     // cout << left << setw(lineWidth) << "  --gc, --grid-cell-size <size>" << "Specify the size of the grid's cells" << endl; // TODO: Implement grid size later
     // cout << left << setw(lineWidth) << "  --substeps <num>" << "Specify the number of substeps" << endl; // TODO: Implement substeps later
     // cout << left << setw(lineWidth) << "  --threads <num>" << "Specify the number of threads to use" << endl; // TODO: Implement threads later
-    // cout << left << setw(lineWidth) << "  --fps <num>" << "Specify the target frames per second" << endl; // TODO: Implement fps later
+    cout << left << setw(lineWidth) << "  --fps <num>" << "Specify the target frames per second" << endl;
+    cout << left << setw(lineWidth) << "  --sim-rate <num>" << "Specify the simulation frames per second (the rendering interpolates)" << endl;
     // cout << left << setw(lineWidth) << "  --add-particles <num>" << "Specify the number of particles to add" << endl; // TODO: Implement add particles later
 }
 
@@ -62,12 +101,79 @@ void Cmd::parse(int argc, char* argv[]) {
             if (i + 1 < argc) {
                 worldFile = argv[i + 1];
                 cout << "World file: " << worldFile << endl;
-                worldFileCommand(worldFile);
                 i++;
             } else {
                 cerr << "Error: No world file specified" << endl;
                 exit(1);
             }
+        } else if (arg == "-r" || arg == "--renderer") {
+            if (i + 1 < argc) {
+                renderer = argv[i + 1];
+                if (renderer != "lod" && renderer != "mesh" && renderer != "impostor") {
+                    cerr << "Error: Unknown renderer " << renderer << " (lod, mesh or impostor)" << endl;
+                    exit(1);
+                }
+                i++;
+            } else {
+                cerr << "Error: No renderer specified" << endl;
+                exit(1);
+            }
+        } else if (arg == "--fps" || arg == "--sim-rate") {
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+                if (arg == "--fps") {
+                    targetFps = atoi(argv[i + 1]);
+                } else {
+                    simulationRate = atoi(argv[i + 1]);
+                }
+                i++;
+            } else {
+                cerr << "Error: " << arg << " needs a positive number" << endl;
+                exit(1);
+            }
+        } else if (arg == "--headless") {
+            if (i + 1 < argc) {
+                headlessDirectory = argv[i + 1];
+                i++;
+            } else {
+                cerr << "Error: No output directory specified" << endl;
+                exit(1);
+            }
+        } else if (arg == "--resolution") {
+            if (i + 1 < argc && sscanf(argv[i + 1], "%dx%d", &width, &height) == 2 && width > 0 && height > 0) {
+                i++;
+            } else {
+                cerr << "Error: --resolution needs <width>x<height>" << endl;
+                exit(1);
+            }
+        } else if (arg == "--stride" || arg == "--frames") {
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) {
+                if (arg == "--stride") {
+                    frameStride = atoi(argv[i + 1]);
+                } else {
+                    maxFrames = atoi(argv[i + 1]);
+                }
+                i++;
+            } else {
+                cerr << "Error: " << arg << " needs a positive number" << endl;
+                exit(1);
+            }
+        } else if (arg == "--format") {
+            if (i + 1 < argc && (string(argv[i + 1]) == "png" || string(argv[i + 1]) == "ppm")) {
+                imageFormat = argv[i + 1];
+                i++;
+            } else {
+                cerr << "Error: --format needs png or ppm" << endl;
+                exit(1);
+            }
+        } else if (arg == "--half") {
+            halfPrecision = true;
+        } else if (arg == "--hot-reload") {
+            hotReload = true;
+        } else if (arg == "--tasks") {
+            taskScheduler = true;
+        } else if (arg == "--task-stats") {
+            taskScheduler = true;
+            taskStats = true;
         } else {
             cerr << "Error: Unknown option " << arg << endl;
             exit(1);
@@ -76,10 +182,14 @@ void Cmd::parse(int argc, char* argv[]) {
 
     if (worldFile == "") {
         cout << "Warning: No world file specified. Using default world file" << endl;
-        worldFileCommand("../data/world_default.json");
+        worldFile = "../data/world_default.json";
     }
 }
 
+void Cmd::loadWorld() {
+    worldFileCommand(worldFile);
+}
+
 void Cmd::worldFileCommand(string file) {
     sim->loadWorld(file);
 }
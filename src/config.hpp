@@ -1,7 +1,5 @@
 #pragma once
 
-#define MAX_PARTICLES 30000
-#define MAX_LINKS 200
 #define CAMERA_FOV 45.0f
 #define WINDOW_WIDTH 800.0f
 #define WINDOW_HEIGHT 800.0f
@@ -10,29 +10,67 @@
 #include "utils/drag_particles.hpp"
 #include "dependencies/glew/glew.h"
 #include "classes/mesh.hpp"
+#include "classes/frameRecorder.hpp"
 #include "cmd.hpp"
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include <memory>
+#include <algorithm>
 
-#define TARGET_FPS 60
 #define NUM_SUBSTEPS 8
 #define ADD_PARTICLE_NUM 10
+#define MAX_FRAME_TIME 0.25f // the simulation doesn't try to catch up more than this after a slow frame
 
 using namespace std;
 
+// hidden window with an OpenGL context when there is no display: first the null platform of GLFW with a software
+// OSMesa context (Mesa llvmpipe), then an EGL context, then the native context of the platform
+GLFWwindow* createHeadlessWindow(int width, int height) {
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    if (glfwInit()) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+        GLFWwindow* window = glfwCreateWindow(width, height, "Particle Simulator", NULL, NULL);
+        if (window) {
+            return window;
+        }
+        glfwTerminate();
+    }
+
+    glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+    if (!glfwInit()) {
+        return nullptr;
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+    GLFWwindow* window = glfwCreateWindow(width, height, "Particle Simulator", NULL, NULL);
+    if (!window) {
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_NATIVE_CONTEXT_API);
+        window = glfwCreateWindow(width, height, "Particle Simulator", NULL, NULL);
+    }
+    return window;
+}
+
 int main(int argc, char* argv[]) {
     cout << "Hello, World!" << endl;
     cout.flush();
 
     // ? setup
 
-    if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW" << std::endl;
-        return -1;
+    // the options are read first since the headless mode changes how the context is created
+    Cmd::parse(argc, argv);
+    bool headless = !Cmd::headlessDirectory.empty();
+
+    GLFWwindow* window = nullptr;
+    if (headless) {
+        window = createHeadlessWindow(Cmd::width, Cmd::height);
+    } else {
+        if (!glfwInit()) {
+            std::cerr << "Failed to initialize GLFW" << std::endl;
+            return -1;
+        }
+        window = glfwCreateWindow(Cmd::width, Cmd::height, "Particle Simulator", NULL, NULL);
     }
-
-    GLFWwindow* window = glfwCreateWindow(800, 800, "Particle Simulator", NULL, NULL);
     if (!window) {
         std::cerr << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -73,15 +111,16 @@ int main(int argc, char* argv[]) {
     Renderer renderer;
 
     // load a model
-    Mesh mesh = Mesh("../models/sphere_ico_low.obj", true, false);
+    Mesh mesh = Mesh("../models/sphere_ico_low.obj"); // the instances come from the sphere stream of the renderer
+    Mesh highMesh = Mesh("../models/sphere.obj"); // close spheres with the lod renderer
     // mesh.addPosition(glm::vec3(0.0f, 1.0f, 0.0f));
     
     // load the mesh for the container
-    Mesh sphereContainerMesh = Mesh("../models/sphere.obj", true, true);
-    Mesh cubeContainerMesh = Mesh("../models/cube.obj", true, true);
+    Mesh sphereContainerMesh = Mesh("../models/sphere.obj", true, true, true);
+    Mesh cubeContainerMesh = Mesh("../models/cube.obj", true, true, true);
 
     // load the particles link mesh
-    Mesh linkMesh = Mesh("../models/cylinder.obj", true, false, true);
+    Mesh linkMesh = Mesh("../models/cylinder.obj"); // the instances come from the link stream of the renderer
 
     // setting up the planes
     // shared_ptr<Plane> floor = make_shared<Plane>(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-0.0f, 1.0f, 0.0f), glm::vec2(10.0f, 10.0f));
@@ -100,6 +139,7 @@ int main(int argc, char* argv[]) {
     glm::vec3 cameraDirection = glm::vec3(0.0f, 0.0f, -1.0f);  // looking towards the negative z-axis
     glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f); // y-axis is up
     Camera camera(cameraPosition, cameraDirection, cameraUp);
+    camera.aspectRatio = (float)Cmd::width / (float)Cmd::height;
     glfwSetWindowUserPointer(window, &camera);
     DragParticles dragParticles(window);
 
@@ -119,11 +159,54 @@ int main(int argc, char* argv[]) {
     // µ Cmd
 
     Cmd::setup(&sim);
-    Cmd::parse(argc, argv);
+    Cmd::loadWorld();
+    renderer.setHalfPrecisionInstances(Cmd::halfPrecision);
+    if (Cmd::hotReload) {
+        renderer.enableShaderHotReload();
+    }
+    if (Cmd::taskScheduler) {
+        sim.enableTaskScheduler();
+    }
+
+    // load the meshes of the mesh containers (one mesh per container since each has its own model)
+    std::vector<Mesh> meshContainerMeshes;
+    for (auto& container : sim.meshContainers) {
+        meshContainerMeshes.push_back(Mesh(std::static_pointer_cast<MeshContainer>(container)->getPath(), true, true, true));
+    }
+    std::vector<Mesh> meshColliderMeshes;
+    for (auto& collider : sim.meshColliders) {
+        meshColliderMeshes.push_back(Mesh(collider->getPath(), true, true, true));
+    }
+
+    // gravity and the attractor of the T key are force fields, applied with the integration at every substep
+    std::shared_ptr<ForceField> gravity = sim.createForceField(ForceField::WIND);
+    gravity->vector = glm::vec3(0.0f, -10.0f, 0.0f);
+    std::shared_ptr<ForceField> attractor = sim.createForceField(ForceField::ATTRACTOR);
+    attractor->strength = 50.0f;
+    attractor->enabled = false;
+    std::shared_ptr<ForceField> lift = sim.createForceField(ForceField::WIND); // counteracts gravity while attracting
+    lift->vector = glm::vec3(0.0f, 10.0f, 0.0f);
+    lift->enabled = false;
+
+    // * the simulation advances by fixed frames at its own rate, the renderer draws between the two last ones
+    float simulationDt = 1.0f / Cmd::simulationRate;
+    float accumulator = 0.0f; // time not simulated yet
+
+    // offscreen rendering: the frames are drawn in a framebuffer and written as images
+    std::unique_ptr<FrameRecorder> recorder;
+    if (headless) {
+        recorder = std::make_unique<FrameRecorder>(Cmd::width, Cmd::height, Cmd::headlessDirectory, Cmd::imageFormat, Cmd::frameStride);
+        if (!recorder->isComplete()) {
+            glfwTerminate();
+            return -1;
+        }
+        recorder->bind();
+        dt = 1.0f / Cmd::targetFps; // every frame advances the video by the same time
+    }
 
     // µ main loop
 
-    while (!glfwWindowShouldClose(window)) {
+    while (!glfwWindowShouldClose(window) && !(headless && Cmd::maxFrames > 0 && nbFrames >= Cmd::maxFrames)) {
 
         // if user press G, add a new sphere
         if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) {
@@ -133,12 +216,8 @@ int main(int argc, char* argv[]) {
         }
 
         // if use press T, attract all the particles to the center and counteract gravity
-        if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS) {
-            for (auto& p : sim.particles) {
-                p->addForce(glm::vec3(0.0f, 10.0f, 0.0f) * (float)NUM_SUBSTEPS); // not very accurate since the force is applied multiple times in the in the same frame (but it's good enough for this purpose)
-                p->addForce(-glm::normalize(p->position) * 50.0f * (float)NUM_SUBSTEPS);
-            }
-        }
+        attractor->enabled = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+        lift->enabled = attractor->enabled;
 
         // Handle camera motion
         handleCameraMotion(window, camera);
@@ -151,34 +230,66 @@ int main(int argc, char* argv[]) {
 
         // Check if 'p' key is pressed (pause the simulation)
         if (glfwGetKey(window, GLFW_KEY_P) != GLFW_PRESS) {
-            // Update simulation
-            float substep_dt = dt / NUM_SUBSTEPS;
-            for (int j = 0; j < NUM_SUBSTEPS; j++) {
-                // sim.checkCollisions();
-                sim.checkGridCollisions();
-                sim.maintainMolecules();
-                sim.addForce(glm::vec3(0.0f, -10.0f, 0.0f));  // gravity
-                sim.step(substep_dt);
+            accumulator += std::min(dt, MAX_FRAME_TIME);
+            while (accumulator >= simulationDt) {
+                sim.publishFrame();
+
+                // Update simulation
+                float substep_dt = simulationDt / NUM_SUBSTEPS;
+                for (int j = 0; j < NUM_SUBSTEPS; j++) {
+                    // sim.checkCollisions();
+                    sim.substep(substep_dt);
+                }
+                accumulator -= simulationDt;
             }
         }
+        renderer.setInterpolation(accumulator / simulationDt, sim.getFrameDisplacement());
+        renderer.reloadShaders();
+        renderer.updateCamera(camera);
 
 
         // Draw particles
         // convert the particles to spheres
-        renderer.draw(camera, sim.spheres, mesh);
-        // renderer.draw(camera, sim.spheres); // using a more efficient shader that doesn't require a model
+        // the grid of the last substep is used to cull the cells out of the view or hidden, even when spheres were emitted or removed since
+        const Grid* cullingGrid = sim.grid.get();
+        size_t griddedSpheres = sim.getGriddedSpheres();
+        if (Cmd::renderer == "impostor") {
+            renderer.draw(camera, sim.spheres, cullingGrid, griddedSpheres); // ray cast impostors, a quad per sphere instead of the 80 triangles of the mesh
+        } else if (Cmd::renderer == "mesh") {
+            renderer.draw(camera, sim.spheres, mesh, cullingGrid, griddedSpheres);
+        } else {
+            renderer.drawLod(camera, sim.spheres, highMesh, mesh, cullingGrid, griddedSpheres); // meshes up close, impostors and points far away
+        }
 
-        renderer.drawMoleculeLinks(camera, sim.molecules, linkMesh);
+        renderer.drawMoleculeLinks(sim.molecules, linkMesh);
 
         // Draw the floor
-        renderer.drawPlanes(camera, sim.planes);
-        // mesh.draw(renderer.modelShaderProgram, camera, {glm::vec3(3.0f, 1.0f, 0.0f)});
+        renderer.drawPlanes(sim.planes);
+
+        // depth of the opaque objects (the transparent containers would hide everything inside them)
+        renderer.captureOcclusionDepth(camera);
+        // mesh.draw(renderer.modelShaderProgram, {glm::vec3(3.0f, 1.0f, 0.0f)});
 
         glEnable(GL_BLEND); // enable transparency
-        renderer.drawContainer(camera, sim.sphereContainers, sphereContainerMesh);
-        renderer.drawContainer(camera, sim.cubeContainers, cubeContainerMesh);
+        renderer.drawContainer(sim.sphereContainers, sphereContainerMesh);
+        renderer.drawContainer(sim.cubeContainers, cubeContainerMesh);
+        for (size_t i = 0; i < sim.meshContainers.size(); i++) {
+            renderer.drawContainer({sim.meshContainers[i]}, meshContainerMeshes[i]);
+        }
+        for (size_t i = 0; i < sim.meshColliders.size(); i++) {
+            renderer.drawMeshCollider(sim.meshColliders[i], meshColliderMeshes[i]);
+        }
         glDisable(GL_BLEND); // disable transparency
 
+        if (headless) {
+            recorder->capture();
+            nbFrames++;
+            if (nbFrames % Cmd::targetFps == 0) {
+                std::cout << "Frame " << nbFrames << " | Number of Particles: " << sim.getNumParticles() << std::endl;
+            }
+            continue; // no window to present, no pacing
+        }
+
         // Swap buffers
         glfwSwapBuffers(window);
 
@@ -186,19 +297,28 @@ int main(int argc, char* argv[]) {
         glfwPollEvents();
 
         // Timing
-        if (nbFrames % TARGET_FPS == 0) {
+        if (nbFrames % Cmd::targetFps == 0) {
             float fps = 1.0f / dt;
             glfwSetWindowTitle(window, ("Particle Simulator | FPS: " + to_string(fps) + " | Number of Particles: " + to_string(sim.getNumParticles())).c_str());
         }
         // Wait until the next frame
         dt = (float)glfwGetTime() - lastTime;
-        while (dt < 1.0f / TARGET_FPS) {
+        while (dt < 1.0f / Cmd::targetFps) {
             dt = (float)glfwGetTime() - lastTime;
         }
         lastTime = (float)glfwGetTime();
         nbFrames++;
     }
 
+    if (recorder) {
+        recorder->finish();
+        std::cout << recorder->getWrittenFrames() << " images written in " << Cmd::headlessDirectory << std::endl;
+        recorder.reset(); // needs the context
+    }
+    if (Cmd::taskStats && sim.getTaskScheduler() != nullptr) {
+        sim.getTaskScheduler()->printStats(std::cout);
+    }
+
     glfwTerminate();
 
     return 0;
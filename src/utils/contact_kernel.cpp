@@ -0,0 +1,100 @@
+#include "contact_kernel.hpp"
+#include <glm/glm.hpp>
+#include <cmath>
+#include <vector>
+#include <memory>
+#include "../classes/particle.hpp"
+
+void ContactBatch::gather(const std::vector<std::shared_ptr<Sphere>>& neighbors) {
+    const size_t n = neighbors.size();
+    spheres.resize(n);
+    x.resize(n); y.resize(n); z.resize(n);
+    radius.resize(n);
+    inverseMass.resize(n);
+    filter.resize(n);
+    dx.resize(n); dy.resize(n); dz.resize(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        Sphere* s = neighbors[i].get();
+        spheres[i] = s;
+        x[i] = s->position.x;
+        y[i] = s->position.y;
+        z[i] = s->position.z;
+        radius[i] = s->radius;
+        inverseMass[i] = s->getInverseMass();
+    }
+}
+
+void ContactBatch::computeFilter(const Sphere& sphere) {
+    const int n = size();
+    self = -1;
+    for (int i = 0; i < n; ++i) {
+        // the sphere itself is also part of its neighborhood, filter it out as well
+        filter[i] = Particle::collisionFilter(sphere, *spheres[i]) * static_cast<float>(spheres[i] != &sphere);
+        self = spheres[i] == &sphere ? i : self;
+    }
+}
+
+int ContactBatch::size() const {
+    return static_cast<int>(spheres.size());
+}
+
+glm::vec3 solveContacts(const Sphere& sphere, ContactBatch& batch) {
+    batch.computeFilter(sphere);
+
+    const int n = batch.size();
+    const float px = sphere.position.x, py = sphere.position.y, pz = sphere.position.z;
+    const float radius = sphere.radius;
+    const float inverseMass = sphere.getInverseMass();
+    const float* bx = batch.x.data();
+    const float* by = batch.y.data();
+    const float* bz = batch.z.data();
+    const float* br = batch.radius.data();
+    const float* bw = batch.inverseMass.data();
+    const float* bf = batch.filter.data();
+    float* dx = batch.dx.data();
+    float* dy = batch.dy.data();
+    float* dz = batch.dz.data();
+    float cx = 0.0f, cy = 0.0f, cz = 0.0f;
+
+    #pragma omp simd reduction(+:cx, cy, cz)
+    for (int i = 0; i < n; ++i) {
+        float ax = px - bx[i];
+        float ay = py - by[i];
+        float az = pz - bz[i];
+        float distance = std::sqrt(ax * ax + ay * ay + az * az);
+        float overlap = std::fmax(radius + br[i] - distance, 0.0f) * bf[i];
+        // the overlap is split between the two spheres proportionally to their inverse masses
+        float scale = overlap / (std::fmax(distance, 1e-6f) * std::fmax(inverseMass + bw[i], 1e-6f));
+        cx += ax * scale * inverseMass;
+        cy += ay * scale * inverseMass;
+        cz += az * scale * inverseMass;
+        dx[i] = -ax * scale * bw[i];
+        dy[i] = -ay * scale * bw[i];
+        dz[i] = -az * scale * bw[i];
+    }
+
+    if (batch.self >= 0) {
+        dx[batch.self] = cx;
+        dy[batch.self] = cy;
+        dz[batch.self] = cz;
+    }
+
+    return glm::vec3(cx, cy, cz);
+}
+
+void scatterContacts(ContactBatch& batch) {
+    const int n = batch.size();
+    #pragma omp simd
+    for (int i = 0; i < n; ++i) {
+        batch.x[i] += batch.dx[i];
+        batch.y[i] += batch.dy[i];
+        batch.z[i] += batch.dz[i];
+    }
+    for (int i = 0; i < n; ++i) {
+        glm::vec3 correction = glm::vec3(batch.dx[i], batch.dy[i], batch.dz[i]);
+        if (correction != glm::vec3(0.0f)) { // only touch the spheres that actually moved
+            batch.spheres[i]->position += correction;
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <memory>
+#include "../classes/particle.hpp"
+
+// Structure of arrays holding the spheres of a grid neighborhood, so the contact response can be vectorized
+struct ContactBatch {
+    std::vector<Sphere*> spheres;
+    std::vector<float> x, y, z;
+    std::vector<float> radius;
+    std::vector<float> inverseMass;
+    std::vector<float> filter; // collision filter of each sphere against the sphere being solved
+    std::vector<float> dx, dy, dz; // corrections computed for each sphere
+    int self = -1; // index of the sphere being solved inside the batch (-1 if it is not part of it)
+
+    void gather(const std::vector<std::shared_ptr<Sphere>>& neighbors);
+    void computeFilter(const Sphere& sphere);
+    int size() const;
+};
+
+// solve the contacts between one sphere and every sphere of the batch, the corrections are weighted by the inverse masses
+// the corrections of the batch are written in dx, dy, dz (including the one of the sphere if it belongs to the batch)
+glm::vec3 solveContacts(const Sphere& sphere, ContactBatch& batch);
+
+// apply the corrections of the batch to the spheres and keep the batch positions up to date
+void scatterContacts(ContactBatch& batch);
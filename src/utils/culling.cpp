@@ -0,0 +1,141 @@
+#include "culling.hpp"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+
+#define HIZ_TILE_SIZE 8 // pixels per side of a tile of the first level
+#define HIZ_MAX_TEXELS 4 // a box is tested at the first level where it covers at most 4x4 texels
+
+Frustum::Frustum(const glm::mat4& m) {
+    // * Gribb-Hartmann: the planes are sums and differences of the rows of the matrix (glm is column major)
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    planes[0] = row3 + row0; // left
+    planes[1] = row3 - row0; // right
+    planes[2] = row3 + row1; // bottom
+    planes[3] = row3 - row1; // top
+    planes[4] = row3 + row2; // near
+    planes[5] = row3 - row2; // far
+}
+
+bool Frustum::intersectsBox(const glm::vec3& min, const glm::vec3& max) const {
+    for (int i = 0; i < 6; i++) {
+        const glm::vec4& p = planes[i];
+        // corner of the box the farthest along the normal of the plane
+        glm::vec3 corner(p.x >= 0.0f ? max.x : min.x, p.y >= 0.0f ? max.y : min.y, p.z >= 0.0f ? max.z : min.z);
+        if (p.x * corner.x + p.y * corner.y + p.z * corner.z + p.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void HiZBuffer::clear() {
+    levels.clear();
+    dims.clear();
+}
+
+void HiZBuffer::build(const float* depth, int width, int height, const glm::mat4& viewProjection) {
+    this->viewProjection = viewProjection;
+    levels.clear();
+    dims.clear();
+
+    // level 0: farthest depth of every tile
+    glm::ivec2 size((width + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE, (height + HIZ_TILE_SIZE - 1) / HIZ_TILE_SIZE);
+    levels.emplace_back(size.x * size.y);
+    dims.push_back(size);
+    std::vector<float>& base = levels[0];
+
+    #pragma omp parallel for
+    for (int ty = 0; ty < size.y; ty++) {
+        for (int tx = 0; tx < size.x; tx++) {
+            float farthest = 0.0f;
+            int yEnd = std::min((ty + 1) * HIZ_TILE_SIZE, height);
+            int xEnd = std::min((tx + 1) * HIZ_TILE_SIZE, width);
+            for (int y = ty * HIZ_TILE_SIZE; y < yEnd; y++) {
+                const float* row = depth + y * width;
+                for (int x = tx * HIZ_TILE_SIZE; x < xEnd; x++) {
+                    farthest = std::max(farthest, row[x]);
+                }
+            }
+            base[ty * size.x + tx] = farthest;
+        }
+    }
+
+    // next levels: farthest of 2x2 texels of the previous one
+    while (size.x > 1 || size.y > 1) {
+        glm::ivec2 next((size.x + 1) / 2, (size.y + 1) / 2);
+        std::vector<float> level(next.x * next.y);
+        const std::vector<float>& previous = levels.back();
+        for (int y = 0; y < next.y; y++) {
+            for (int x = 0; x < next.x; x++) {
+                float farthest = 0.0f;
+                for (int dy = 0; dy < 2; dy++) {
+                    for (int dx = 0; dx < 2; dx++) {
+                        int px = std::min(2 * x + dx, size.x - 1);
+                        int py = std::min(2 * y + dy, size.y - 1);
+                        farthest = std::max(farthest, previous[py * size.x + px]);
+                    }
+                }
+                level[y * next.x + x] = farthest;
+            }
+        }
+        levels.push_back(std::move(level));
+        dims.push_back(next);
+        size = next;
+    }
+}
+
+bool HiZBuffer::isOccluded(const glm::vec3& min, const glm::vec3& max) const {
+    if (levels.empty()) {
+        return false;
+    }
+
+    // screen rectangle and nearest depth of the box
+    glm::vec2 rectMin(1.0f), rectMax(0.0f);
+    float nearest = 1.0f;
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z);
+        glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+        if (clip.w <= 0.0f) {
+            return false; // the box crosses the camera plane
+        }
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        glm::vec2 window = glm::vec2(ndc.x, ndc.y) * 0.5f + 0.5f;
+        rectMin = glm::min(rectMin, window);
+        rectMax = glm::max(rectMax, window);
+        nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+    }
+    if (nearest <= 0.0f) {
+        return false;
+    }
+    rectMin = glm::clamp(rectMin, glm::vec2(0.0f), glm::vec2(1.0f));
+    rectMax = glm::clamp(rectMax, glm::vec2(0.0f), glm::vec2(1.0f));
+
+    // first level where the rectangle covers a few texels
+    int level = 0;
+    glm::ivec2 texelMin, texelMax;
+    while (true) {
+        glm::vec2 size = glm::vec2(dims[level]);
+        texelMin = glm::ivec2(glm::floor(rectMin * size));
+        texelMax = glm::min(glm::ivec2(glm::floor(rectMax * size)), dims[level] - 1);
+        if ((texelMax.x - texelMin.x < HIZ_MAX_TEXELS && texelMax.y - texelMin.y < HIZ_MAX_TEXELS) || level + 1 == static_cast<int>(levels.size())) {
+            break;
+        }
+        level++;
+    }
+
+    // occluded if the box is behind the farthest depth of every texel it covers
+    const std::vector<float>& texels = levels[level];
+    for (int y = texelMin.y; y <= texelMax.y; y++) {
+        for (int x = texelMin.x; x <= texelMax.x; x++) {
+            if (nearest <= texels[y * dims[level].x + x]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// planes of the view frustum extracted from a view projection matrix (normals pointing inside)
+struct Frustum {
+    glm::vec4 planes[6];
+
+    Frustum(const glm::mat4& viewProjection);
+    bool intersectsBox(const glm::vec3& min, const glm::vec3& max) const; // conservative: some boxes outside near the corners pass
+};
+
+// coarse hierarchical Z buffer: pyramid of the farthest depth per tile, built on the CPU from a depth buffer
+class HiZBuffer {
+public:
+    // reduce a depth buffer (window depths in [0, 1], row 0 at the bottom) to tiles of HIZ_TILE_SIZE pixels and build the pyramid
+    void build(const float* depth, int width, int height, const glm::mat4& viewProjection);
+    void clear();
+    bool isEmpty() const { return levels.empty(); }
+    // whether the box is behind the depth buffer everywhere it covers, seen with the matrix of the depth buffer
+    bool isOccluded(const glm::vec3& min, const glm::vec3& max) const;
+    const glm::mat4& getViewProjection() const { return viewProjection; }
+
+private:
+    glm::mat4 viewProjection; // matrix the depth buffer was rendered with
+    std::vector<std::vector<float>> levels; // level 0 is the tile grid, each next level halves it
+    std::vector<glm::ivec2> dims;
+};
@@ -41,16 +41,38 @@ void DragParticles::setIsDragging(bool isDragging) {
     this->isDragging = isDragging;
 }
 
+glm::vec3 DragParticles::getMouseRay(const Camera &camera, glm::vec2 mousePos, float depth) {
+    if (camera.aspectRatio != inverseProjectionAspect) {
+        inverseProjection = glm::inverse(camera.getProjectionMatrix(CAMERA_FOV, camera.aspectRatio, CAMERA_NEAR, CAMERA_FAR));
+        inverseProjectionAspect = camera.aspectRatio;
+    }
+
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+
+    // Convert the 2D mouse position to normalized device coordinates
+    glm::vec4 ray_clip = glm::vec4((2.0f * mousePos.x) / width - 1.0f, 1.0f - (2.0f * mousePos.y) / height, depth, 1.0f);
+    glm::vec4 ray_eye = inverseProjection * ray_clip;
+    ray_eye = glm::vec4(ray_eye.x, ray_eye.y, -1.0f, 0.0f);
+
+    // the view matrix is a rotation and a translation, the inverse of its rotation is its transpose
+    glm::mat3 inverseRotation = glm::transpose(glm::mat3(camera.getViewMatrix()));
+    return glm::normalize(inverseRotation * glm::vec3(ray_eye));
+}
+
 void DragParticles::handleDrag(const Camera &camera, Simulation &simulation) {
+    // the dragged particle may have been removed from the simulation (by a sink)
+    if (draggedParticle && draggedParticle->removed) {
+        draggedParticle = nullptr;
+    }
+
     if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
         double x, y;
         glfwGetCursorPos(window, &x, &y);
         glm::vec2 mousePos = glm::vec2(x, y);
 
-        // Get the camera position and view matrix  
+        // Get the camera position
         glm::vec3 cameraPosition = camera.position;
-        glm::mat4 viewMatrix = camera.getViewMatrix();
-        glm::mat4 projectionMatrix = camera.getProjectionMatrix(45.0f, (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 0.1f, 100.0f);
 
         if (!isDragging) {
             isDragging = true;
@@ -59,30 +81,16 @@ void DragParticles::handleDrag(const Camera &camera, Simulation &simulation) {
             // handle getting the particle to drag
 
 
-            // Convert the 2D mouse position to normalized device coordinates
-            glm::vec4 ray_clip = glm::vec4((2.0f * mousePos.x) / WINDOW_WIDTH - 1.0f, 1.0f - (2.0f * mousePos.y) / WINDOW_HEIGHT, -1.0f, 1.0f);
-            glm::vec4 ray_eye = glm::inverse(projectionMatrix) * ray_clip;
-            ray_eye = glm::vec4(ray_eye.x, ray_eye.y, -1.0f, 0.0f);
-            glm::vec3 ray_world = glm::vec3(glm::inverse(viewMatrix) * ray_eye);
-
             // Create a ray from the camera position in the direction of the mouse click
-            Ray ray(cameraPosition, glm::normalize(ray_world));
-
-            // Check for intersections between the ray and the particles
-            std::shared_ptr<Sphere> selectedParticle = nullptr;
-            float minDistance = std::numeric_limits<float>::max();
-            for (auto& particle : simulation.spheres) {
-                float distance = ray.intersect(particle);
-                if (distance < minDistance) {
-                    selectedParticle = particle;
-                    minDistance = distance;
-                }
-            }
+            Ray ray(cameraPosition, getMouseRay(camera, mousePos, -1.0f));
+
+            // first particle along the ray, only the spheres of the grid cells crossed by the ray are tested
+            RayHit hit = simulation.raycast(ray);
 
             // If there's an intersection, set the intersected particle as the dragged particle
-            if (selectedParticle) {
-                setDraggedParticle(selectedParticle);
-                setDragDistance(minDistance);
+            if (hit.sphere) {
+                setDraggedParticle(hit.sphere);
+                setDragDistance(hit.distance);
             }
 
         }
@@ -108,11 +116,7 @@ void DragParticles::handleDrag(const Camera &camera, Simulation &simulation) {
                 // Update the last mouse position
                 lastMousePos = mousePos;
             } else {
-                // Convert the 2D mouse position to normalized device coordinates
-                glm::vec4 ray_clip = glm::vec4((2.0f * mousePos.x) / WINDOW_WIDTH - 1.0f, 1.0f - (2.0f * mousePos.y) / WINDOW_HEIGHT, 1.0f, 1.0f);
-                glm::vec4 ray_eye = glm::inverse(projectionMatrix) * ray_clip;
-                ray_eye = glm::vec4(ray_eye.x, ray_eye.y, -1.0f, 0.0f);
-                glm::vec3 ray_world = glm::normalize(glm::vec3(glm::inverse(viewMatrix) * ray_eye));
+                glm::vec3 ray_world = getMouseRay(camera, mousePos, 1.0f);
 
                 // Calculate the new position of the particle
                 glm::vec3 newPosition = camera.position + ray_world * dragDistance;
@@ -18,6 +18,10 @@ class DragParticles { // ! only for spheres for the moment
         std::shared_ptr<Sphere> draggedParticle;
         float dragDistance = 0.0f;
         bool fixedDrag = true; // fixedDrag is used to get a precise position for the dragged particle instead of adding a kind of force to the particle
+        glm::mat4 inverseProjection; // cached, the projection only changes with the aspect ratio
+        float inverseProjectionAspect = 0.0f;
+
+        glm::vec3 getMouseRay(const Camera &camera, glm::vec2 mousePos, float depth); // world direction of the ray through the mouse
 
     public:
         DragParticles(GLFWwindow* window, bool fixedDrag = true);
@@ -0,0 +1,33 @@
+#include "file_stamp.hpp"
+#include <filesystem>
+#include <random>
+
+bool getSourceStamp(const std::string& path, uint64_t& size, int64_t& time) {
+    std::error_code error;
+    size = static_cast<uint64_t>(std::filesystem::file_size(path, error));
+    if (error) return false;
+    time = static_cast<int64_t>(std::filesystem::last_write_time(path, error).time_since_epoch().count());
+    return !error;
+}
+
+bool writeCacheFile(const std::string& path, const std::function<void(std::ofstream&)>& write) {
+    std::string temporary = path + "." + std::to_string(std::random_device{}()) + ".tmp";
+    std::error_code error;
+    {
+        std::ofstream file(temporary, std::ios::binary);
+        if (file) {
+            write(file);
+        }
+        if (!file) {
+            file.close();
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
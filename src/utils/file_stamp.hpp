@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+
+// size and modification time of a file, stored in the caches built from it to detect when it changes
+bool getSourceStamp(const std::string& path, uint64_t& size, int64_t& time);
+
+// write a cache through a temporary file renamed over it, runs started at the same time never read a partial cache
+bool writeCacheFile(const std::string& path, const std::function<void(std::ofstream&)>& write);
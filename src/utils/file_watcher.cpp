@@ -0,0 +1,62 @@
+#include "file_watcher.hpp"
+#include <algorithm>
+#include <chrono>
+
+FileWatcher::FileWatcher(const std::string& directory, int intervalMs) : directory(directory), intervalMs(intervalMs) {
+    scan(false); // the files as they are now are the reference
+    thread = std::thread(&FileWatcher::watchLoop, this);
+}
+
+FileWatcher::~FileWatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    stopSignal.notify_all();
+    thread.join();
+}
+
+std::vector<std::string> FileWatcher::takeChanges() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> taken;
+    taken.swap(changes);
+    return taken;
+}
+
+void FileWatcher::scan(bool report) {
+    std::error_code error;
+    std::vector<std::string> modified;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        if (!entry.is_regular_file(error)) {
+            continue;
+        }
+        std::string name = entry.path().filename().string();
+        std::filesystem::file_time_type time = entry.last_write_time(error);
+        if (error) {
+            continue; // ? the file may be replaced by the editor right now, it's seen at the next scan
+        }
+        auto it = times.find(name);
+        if (it == times.end() || it->second != time) {
+            times[name] = time;
+            modified.push_back(name);
+        }
+    }
+
+    if (report && !modified.empty()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& name : modified) {
+            if (std::find(changes.begin(), changes.end(), name) == changes.end()) {
+                changes.push_back(name);
+            }
+        }
+    }
+}
+
+void FileWatcher::watchLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopSignal.wait_for(lock, std::chrono::milliseconds(intervalMs), [this] { return stopping; })) {
+        lock.unlock();
+        scan(true);
+        lock.lock();
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <filesystem>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// polls the modification times of the files of a directory in a background thread
+class FileWatcher {
+public:
+    FileWatcher(const std::string& directory, int intervalMs = 250);
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    std::vector<std::string> takeChanges(); // names of the files modified since the last call, cheap when nothing changed
+
+private:
+    std::string directory;
+    int intervalMs;
+    std::map<std::string, std::filesystem::file_time_type> times; // only used by the watching thread
+
+    std::vector<std::string> changes;
+    std::mutex mutex;
+    std::condition_variable stopSignal;
+    bool stopping = false;
+    std::thread thread;
+
+    void scan(bool report);
+    void watchLoop();
+};
@@ -0,0 +1,291 @@
+#include "image_writer.hpp"
+#include <fstream>
+#include <vector>
+#include <cstdint>
+#include <array>
+#include <algorithm>
+#include <cstdlib>
+
+#define DEFLATE_WINDOW 32768 // largest distance of a match
+#define DEFLATE_HASH_BITS 15 // size of the table of the chains, indexed by the hash of 3 bytes
+#define DEFLATE_MAX_CHAIN 32 // candidates tried per position, the speed and ratio trade off
+#define DEFLATE_MAX_MATCH 258
+
+bool writePPM(const std::string& path, const unsigned char* pixels, int width, int height) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    file << "P6\n" << width << " " << height << "\n255\n";
+
+    std::vector<unsigned char> row(width * 3);
+    for (int y = height - 1; y >= 0; y--) { // top row first
+        const unsigned char* source = pixels + static_cast<size_t>(y) * width * 4;
+        for (int x = 0; x < width; x++) {
+            row[x * 3 + 0] = source[x * 4 + 0];
+            row[x * 3 + 1] = source[x * 4 + 1];
+            row[x * 3 + 2] = source[x * 4 + 2];
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size());
+    }
+    return static_cast<bool>(file);
+}
+
+static uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+    // built once, thread safe initialization of a local static
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t;
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void putBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+    out.push_back(value >> 24);
+    out.push_back((value >> 16) & 0xFF);
+    out.push_back((value >> 8) & 0xFF);
+    out.push_back(value & 0xFF);
+}
+
+static void writeChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data) {
+    std::vector<unsigned char> chunk;
+    putBigEndian(chunk, static_cast<uint32_t>(data.size()));
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    putBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+    file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+}
+
+// bits are packed from the least significant one, as deflate reads them
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<unsigned char>& out) : out(out) {}
+
+    void put(uint32_t value, int count) {
+        buffer |= static_cast<uint64_t>(value) << used;
+        used += count;
+        while (used >= 8) {
+            out.push_back(buffer & 0xFF);
+            buffer >>= 8;
+            used -= 8;
+        }
+    }
+    void flush() {
+        if (used > 0) {
+            out.push_back(buffer & 0xFF);
+        }
+        buffer = 0;
+        used = 0;
+    }
+
+private:
+    std::vector<unsigned char>& out;
+    uint64_t buffer = 0;
+    int used = 0;
+};
+
+static const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// the Huffman codes are stored from their most significant bit, reversed once here
+static uint32_t reverseBits(uint32_t code, int length) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < length; i++) {
+        reversed |= ((code >> i) & 1) << (length - 1 - i);
+    }
+    return reversed;
+}
+
+// fixed Huffman code of deflate for the literals, the end of block and the lengths
+struct FixedCode {
+    uint16_t code[288];
+    uint8_t length[288];
+
+    FixedCode() {
+        for (int symbol = 0; symbol < 288; symbol++) {
+            if (symbol < 144) set(symbol, 0x30 + symbol, 8);
+            else if (symbol < 256) set(symbol, 0x190 + symbol - 144, 9);
+            else if (symbol < 280) set(symbol, symbol - 256, 7);
+            else set(symbol, 0xC0 + symbol - 280, 8);
+        }
+    }
+    void set(int symbol, uint32_t value, int bits) {
+        code[symbol] = static_cast<uint16_t>(reverseBits(value, bits));
+        length[symbol] = static_cast<uint8_t>(bits);
+    }
+};
+
+static void putFixedSymbol(BitWriter& bits, int symbol) {
+    static const FixedCode fixed; // thread safe initialization of a local static
+    bits.put(fixed.code[symbol], fixed.length[symbol]);
+}
+
+static void putMatch(BitWriter& bits, int length, int distance) {
+    int l = 0;
+    while (l < 28 && lengthBase[l + 1] <= length) l++;
+    putFixedSymbol(bits, 257 + l);
+    bits.put(length - lengthBase[l], lengthExtra[l]);
+    int d = 0;
+    while (d < 29 && distanceBase[d + 1] <= distance) d++;
+    bits.put(reverseBits(d, 5), 5);
+    bits.put(distance - distanceBase[d], distanceExtra[d]);
+}
+
+// * one deflate block with the fixed Huffman code, the repetitions are found with hash chains over a 32 KB window
+// (the rendered frames are mostly runs of the background and of similar rows, which the matches catch)
+static void deflate(const std::vector<unsigned char>& data, std::vector<unsigned char>& out) {
+    BitWriter bits(out);
+    bits.put(1, 1); // last block
+    bits.put(1, 2); // fixed Huffman code
+
+    const int size = static_cast<int>(data.size());
+    std::vector<int> head(1 << DEFLATE_HASH_BITS, -1);
+    std::vector<int> previous(DEFLATE_WINDOW);
+    auto hashAt = [&](int i) {
+        uint32_t v = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16);
+        return (v * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+    };
+    auto insert = [&](int i) {
+        if (i + 2 < size) {
+            uint32_t h = hashAt(i);
+            previous[i & (DEFLATE_WINDOW - 1)] = head[h];
+            head[h] = i;
+        }
+    };
+
+    int i = 0;
+    while (i < size) {
+        int bestLength = 0, bestDistance = 0;
+        if (i + 2 < size) {
+            int maxLength = std::min(DEFLATE_MAX_MATCH, size - i);
+            int candidate = head[hashAt(i)];
+            for (int chain = 0; chain < DEFLATE_MAX_CHAIN && candidate >= 0 && i - candidate <= DEFLATE_WINDOW - 1; chain++) {
+                if (data[candidate + bestLength] == data[i + bestLength]) {
+                    int length = 0;
+                    while (length < maxLength && data[candidate + length] == data[i + length]) length++;
+                    if (length > bestLength) {
+                        bestLength = length;
+                        bestDistance = i - candidate;
+                        if (length == maxLength) break;
+                    }
+                }
+                candidate = previous[candidate & (DEFLATE_WINDOW - 1)];
+            }
+        }
+        if (bestLength >= 3) {
+            putMatch(bits, bestLength, bestDistance);
+            for (int k = 0; k < bestLength; k++) {
+                insert(i + k);
+            }
+            i += bestLength;
+        } else {
+            putFixedSymbol(bits, data[i]);
+            insert(i);
+            i++;
+        }
+    }
+    putFixedSymbol(bits, 256); // end of block
+    bits.flush();
+}
+
+static uint32_t adler32(const std::vector<unsigned char>& data) {
+    uint32_t a = 1, b = 0;
+    size_t i = 0;
+    while (i < data.size()) {
+        // 5552 bytes is the most that can be summed before the modulo without overflowing b
+        size_t end = std::min(data.size(), i + 5552);
+        for (; i < end; i++) {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+static int paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return a;
+    return pb <= pc ? b : c;
+}
+
+bool writePNG(const std::string& path, const unsigned char* pixels, int width, int height) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    file.write(reinterpret_cast<const char*>(signature), 8);
+
+    std::vector<unsigned char> header;
+    putBigEndian(header, width);
+    putBigEndian(header, height);
+    header.insert(header.end(), {8, 2, 0, 0, 0}); // 8 bits, RGB, deflate, adaptive filtering, no interlace
+    writeChunk(file, "IHDR", header);
+
+    // * filtered scanlines, top row first: every row takes the filter with the smallest sum of absolute differences
+    const size_t stride = static_cast<size_t>(width) * 3;
+    std::vector<unsigned char> raw;
+    raw.reserve(static_cast<size_t>(height) * (stride + 1));
+    std::vector<unsigned char> row(stride), above(stride, 0);
+    std::vector<unsigned char> candidates[5];
+    for (auto& candidate : candidates) {
+        candidate.resize(stride);
+    }
+    for (int y = height - 1; y >= 0; y--) {
+        const unsigned char* source = pixels + static_cast<size_t>(y) * width * 4;
+        for (int x = 0; x < width; x++) {
+            row[x * 3 + 0] = source[x * 4 + 0];
+            row[x * 3 + 1] = source[x * 4 + 1];
+            row[x * 3 + 2] = source[x * 4 + 2];
+        }
+        // none, sub, up, average and paeth, the first pixel has no left neighbor
+        for (size_t i = 0; i < stride; i++) {
+            int left = i >= 3 ? row[i - 3] : 0;
+            int upLeft = i >= 3 ? above[i - 3] : 0;
+            candidates[0][i] = row[i];
+            candidates[1][i] = static_cast<unsigned char>(row[i] - left);
+            candidates[2][i] = static_cast<unsigned char>(row[i] - above[i]);
+            candidates[3][i] = static_cast<unsigned char>(row[i] - (left + above[i]) / 2);
+            candidates[4][i] = static_cast<unsigned char>(row[i] - paeth(left, above[i], upLeft));
+        }
+        int bestFilter = 0;
+        long bestScore = -1;
+        for (int filter = 0; filter < 5; filter++) {
+            long score = 0;
+            for (unsigned char value : candidates[filter]) {
+                score += value < 128 ? value : 256 - value;
+            }
+            if (bestScore < 0 || score < bestScore) {
+                bestScore = score;
+                bestFilter = filter;
+            }
+        }
+        raw.push_back(static_cast<unsigned char>(bestFilter));
+        raw.insert(raw.end(), candidates[bestFilter].begin(), candidates[bestFilter].end());
+        std::swap(row, above);
+    }
+
+    std::vector<unsigned char> data = {0x78, 0x01}; // zlib header: deflate, 32 KB window
+    deflate(raw, data);
+    putBigEndian(data, adler32(raw));
+    writeChunk(file, "IDAT", data);
+    writeChunk(file, "IEND", {});
+
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+// write an 8 bit RGBA image as RGB, the rows are given from the bottom (as read back from OpenGL)
+bool writePPM(const std::string& path, const unsigned char* pixels, int width, int height);
+bool writePNG(const std::string& path, const unsigned char* pixels, int width, int height); // filtered rows compressed by a small deflate encoder (fixed Huffman code), no dependency
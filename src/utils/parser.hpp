@@ -5,6 +5,15 @@
 #include "../classes/grid.hpp"
 #include "../classes/particle.hpp"
 #include "../classes/molecule.hpp"
+#include "../classes/fluid.hpp"
+#include "../classes/meshCollider.hpp"
+#include "../classes/plane.hpp"
+#include "../classes/kinematicMotion.hpp"
+#include "../classes/longRangeForce.hpp"
+#include "../classes/forceField.hpp"
+#include "../classes/emitter.hpp"
+#include "../classes/sink.hpp"
+#include <algorithm>
 #include <fstream>
 #include <json.hpp>
 #include <memory>
@@ -15,7 +24,25 @@ using json = nlohmann::json;
 
 std::shared_ptr<Sphere> parseSphere(json j);  // parse a sphere from a json object
 std::shared_ptr<Molecule> parseMolecule(json j);  // parse a molecule from a json object
+std::shared_ptr<Fluid> parseFluid(json j);  // parse a fluid (its spheres and an optional block of spheres) from a json object
 std::shared_ptr<Container> parseContainer(json j);  // parse a container from a json object
+void parseCollisionFilter(json j, Particle* particle);  // parse the optional collision group and mask of a particle
+std::shared_ptr<MeshCollider> parseCollider(json j);  // parse a static collider from a json object
+std::shared_ptr<Plane> parsePlane(json j);  // parse a plane from a json object (needs an OpenGL context for its texture)
+std::shared_ptr<KinematicMotion> parseMotion(json j, glm::vec3 position);  // parse the scripted motion of an object placed at position
+LongRangeForce parseLongRange(json j);  // parse the settings of the long range force of a world
+std::shared_ptr<ForceField> parseForceField(json j);  // parse a force field from a json object
+std::shared_ptr<Emitter> parseEmitter(json j);  // parse a sphere emitter from a json object
+std::shared_ptr<Sink> parseSink(json j);  // parse a sink volume from a json object
+
+void parseCollisionFilter(json j, Particle* particle) {
+    if (j.find("collisionGroup") != j.end()) {
+        particle->collisionGroup = j["collisionGroup"];
+    }
+    if (j.find("collisionMask") != j.end()) {
+        particle->collisionMask = j["collisionMask"];
+    }
+}
 
 std::shared_ptr<Sphere> parseSphere(json j) {
     // init the parameters
@@ -51,6 +78,16 @@ std::shared_ptr<Sphere> parseSphere(json j) {
             fixed
         );
 
+        if (j.find("mass") != j.end()) {
+            sphere->setMass(j["mass"]);
+        }
+
+        if (j.find("charge") != j.end()) {
+            sphere->charge = j["charge"];
+        }
+
+        parseCollisionFilter(j, sphere.get());
+
         return sphere;
 }
 
@@ -84,9 +121,15 @@ std::shared_ptr<Molecule> parseMolecule(json j) {
     // Create a vector to store the spheres
     std::vector<std::shared_ptr<Sphere>> spheres;
 
+    if (j.find("skipLinkedCollisions") != j.end()) {
+        molecule->setSkipLinkedCollisions(j["skipLinkedCollisions"]);
+    }
+
     // Iterate over the spheres in the molecule
     for (const auto& jSphere : j["spheres"]) {
         std::shared_ptr<Sphere> sphere = parseSphere(jSphere);
+        parseCollisionFilter(j, sphere.get()); // the molecule's filter applies to all its spheres
+        parseCollisionFilter(jSphere, sphere.get()); // but a sphere can still override it
         sphere->position += offset;
         sphere->previous_position = sphere->position;
         molecule->addSphere(sphere);
@@ -104,12 +147,71 @@ std::shared_ptr<Molecule> parseMolecule(json j) {
     return molecule;
 }
 
+std::shared_ptr<Fluid> parseFluid(json j) {
+    std::shared_ptr<Fluid> fluid = std::make_shared<Fluid>();
+
+    // check for optional parameters
+    if (j.find("restDensity") != j.end()) {
+        fluid->restDensity = j["restDensity"];
+    }
+    if (j.find("smoothingRadius") != j.end()) {
+        fluid->smoothingRadius = j["smoothingRadius"];
+    }
+    if (j.find("viscosity") != j.end()) {
+        fluid->viscosity = j["viscosity"];
+    }
+    if (j.find("relaxation") != j.end()) {
+        fluid->relaxation = j["relaxation"];
+    }
+    if (j.find("iterations") != j.end()) {
+        fluid->iterations = j["iterations"];
+    }
+
+    for (const auto& jSphere : j["spheres"]) {
+        std::shared_ptr<Sphere> sphere = parseSphere(jSphere);
+        if (sphere != nullptr) {
+            fluid->addSphere(sphere);
+        }
+    }
+
+    // a box filled with spheres touching each other, fluids need too many particles to list them
+    if (j.find("block") != j.end()) {
+        json jBlock = j["block"];
+        glm::vec3 min = glm::vec3(jBlock["min"][0], jBlock["min"][1], jBlock["min"][2]);
+        glm::vec3 max = glm::vec3(jBlock["max"][0], jBlock["max"][1], jBlock["max"][2]);
+        float radius = jBlock["radius"];
+        float mass = 1.0f;
+        if (jBlock.find("mass") != jBlock.end()) {
+            mass = jBlock["mass"];
+        }
+        for (float z = min.z + radius; z <= max.z - radius; z += 2.0f * radius) {
+            for (float y = min.y + radius; y <= max.y - radius; y += 2.0f * radius) {
+                for (float x = min.x + radius; x <= max.x - radius; x += 2.0f * radius) {
+                    std::shared_ptr<Sphere> sphere = std::make_shared<Sphere>(glm::vec3(x, y, z), radius, glm::vec3(0.0f), glm::vec3(0.0f), false);
+                    sphere->setMass(mass);
+                    fluid->addSphere(sphere);
+                }
+            }
+        }
+    }
+
+    if (fluid->spheres.empty()) {
+        std::cerr << "Fluid without spheres" << std::endl;
+        return nullptr;
+    }
+
+    return fluid;
+}
+
 std::shared_ptr<Container> parseContainer(json j) {
     // init the parameters
     std::string type;
     glm::vec3 position;
     glm::vec3 size; // either size or radius
     float radius;
+    std::string path; // for the mesh containers
+    int resolution = 64;
+    float scale = 1.0f;
     bool forcedInside = false;
 
     // check for optional parameters
@@ -124,6 +226,14 @@ std::shared_ptr<Container> parseContainer(json j) {
         size = glm::vec3(j["size"][0], j["size"][1], j["size"][2]);
     } else if (type == "sphere") {
         radius = j["radius"];
+    } else if (type == "mesh") {
+        path = j["path"];
+        if (j.find("resolution") != j.end()) {
+            resolution = j["resolution"];
+        }
+        if (j.find("scale") != j.end()) {
+            scale = j["scale"];
+        }
     } else {
         std::cerr << "Unknown container type: " << type << std::endl;
         return nullptr;
@@ -143,7 +253,264 @@ std::shared_ptr<Container> parseContainer(json j) {
             glm::vec3(radius * 2.0f),
             forcedInside
         );
+    } else if (type == "mesh") {
+        container = std::make_shared<MeshContainer>(
+            position,
+            path,
+            resolution,
+            scale,
+            forcedInside
+        );
+    }
+
+    // optional wall response
+    if (j.find("restitution") != j.end()) {
+        container->setRestitution(j["restitution"]);
+    }
+    if (j.find("friction") != j.end()) {
+        container->setFriction(j["friction"]);
+    }
+
+    // optional scripted motion
+    if (j.find("motion") != j.end()) {
+        std::shared_ptr<KinematicMotion> motion = parseMotion(j["motion"], position);
+        if (motion == nullptr) {
+            return nullptr;
+        }
+        container->setMotion(motion);
     }
 
     return container;
-}
\ No newline at end of file
+}
+
+std::shared_ptr<KinematicMotion> parseMotion(json j, glm::vec3 position) {
+    std::shared_ptr<KinematicMotion> motion = std::make_shared<KinematicMotion>();
+    std::string type = j["type"];
+
+    if (j.find("axis") != j.end()) {
+        motion->axis = glm::vec3(j["axis"][0], j["axis"][1], j["axis"][2]);
+    }
+
+    if (type == "linear") {
+        motion->type = KinematicMotion::LINEAR;
+        motion->velocity = glm::vec3(j["velocity"][0], j["velocity"][1], j["velocity"][2]);
+    } else if (type == "rotation") {
+        motion->type = KinematicMotion::ROTATION;
+        motion->angularSpeed = j["speed"];
+        motion->pivot = position; // rotating around itself by default
+        if (j.find("pivot") != j.end()) {
+            motion->pivot = glm::vec3(j["pivot"][0], j["pivot"][1], j["pivot"][2]);
+        }
+    } else if (type == "keyframes") {
+        motion->type = KinematicMotion::KEYFRAMES;
+        if (j.find("loop") != j.end()) {
+            motion->loop = j["loop"];
+        }
+        for (auto& k : j["keyframes"]) {
+            KinematicMotion::Keyframe keyframe;
+            keyframe.time = k["time"];
+            keyframe.position = position;
+            keyframe.angle = 0.0f;
+            if (k.find("position") != k.end()) {
+                keyframe.position = glm::vec3(k["position"][0], k["position"][1], k["position"][2]);
+            }
+            if (k.find("angle") != k.end()) {
+                keyframe.angle = k["angle"];
+            }
+            motion->keyframes.push_back(keyframe);
+        }
+        std::sort(motion->keyframes.begin(), motion->keyframes.end(), [](const KinematicMotion::Keyframe& a, const KinematicMotion::Keyframe& b) {
+            return a.time < b.time;
+        });
+    } else {
+        std::cerr << "Unknown motion type: " << type << std::endl;
+        return nullptr;
+    }
+
+    return motion;
+}
+
+std::shared_ptr<MeshCollider> parseCollider(json j) {
+    std::string type = j["type"];
+    if (type != "mesh") {
+        std::cerr << "Unknown collider type: " << type << std::endl;
+        return nullptr;
+    }
+
+    // init the parameters
+    glm::vec3 position = glm::vec3(0.0f);
+    float scale = 1.0f;
+
+    // check for optional parameters
+    if (j.find("position") != j.end()) {
+        position = glm::vec3(j["position"][0], j["position"][1], j["position"][2]);
+    }
+    if (j.find("scale") != j.end()) {
+        scale = j["scale"];
+    }
+
+    std::shared_ptr<MeshCollider> collider = std::make_shared<MeshCollider>(position, j["path"], scale);
+
+    if (j.find("restitution") != j.end()) {
+        collider->restitution = j["restitution"];
+    }
+    if (j.find("friction") != j.end()) {
+        collider->friction = j["friction"];
+    }
+
+    return collider;
+}
+
+std::shared_ptr<Plane> parsePlane(json j) {
+    glm::vec3 position = glm::vec3(j["position"][0], j["position"][1], j["position"][2]);
+    glm::vec3 normal = glm::vec3(j["normal"][0], j["normal"][1], j["normal"][2]);
+    glm::vec2 size = glm::vec2(j["size"][0], j["size"][1]);
+    return std::make_shared<Plane>(position, normal, size);
+}
+
+LongRangeForce parseLongRange(json j) {
+    LongRangeForce settings;
+    settings.enabled = true;
+
+    std::string type = "gravity";
+    if (j.find("type") != j.end()) {
+        type = j["type"];
+    }
+    if (type == "gravity") {
+        settings.interaction = LongRangeForce::GRAVITY;
+    } else if (type == "coulomb") {
+        settings.interaction = LongRangeForce::COULOMB;
+    } else {
+        std::cerr << "Unknown long range force type: " << type << std::endl;
+        settings.enabled = false;
+        return settings;
+    }
+
+    if (j.find("constant") != j.end()) {
+        settings.constant = j["constant"];
+    }
+    if (j.find("softening") != j.end()) {
+        settings.softening = j["softening"];
+    }
+    if (j.find("theta") != j.end()) {
+        settings.theta = j["theta"];
+    }
+
+    if (j.find("method") != j.end()) {
+        std::string method = j["method"];
+        if (method == "barnesHut") {
+            settings.method = LongRangeForce::BARNES_HUT;
+        } else if (method == "particleMesh") {
+            settings.method = LongRangeForce::PARTICLE_MESH;
+        } else {
+            std::cerr << "Unknown long range method: " << method << std::endl;
+        }
+    }
+    if (j.find("resolution") != j.end()) {
+        settings.resolution = j["resolution"];
+    }
+
+    return settings;
+}
+
+std::shared_ptr<ForceField> parseForceField(json j) {
+    std::string type = j["type"];
+    std::shared_ptr<ForceField> field;
+    if (type == "attractor") {
+        field = std::make_shared<ForceField>(ForceField::ATTRACTOR);
+        if (j.find("falloff") != j.end()) {
+            field->inverseSquare = j["falloff"] == "inverseSquare";
+        }
+    } else if (type == "vortex") {
+        field = std::make_shared<ForceField>(ForceField::VORTEX);
+        if (j.find("axis") != j.end()) {
+            field->axis = glm::vec3(j["axis"][0], j["axis"][1], j["axis"][2]);
+        }
+    } else if (type == "wind") {
+        field = std::make_shared<ForceField>(ForceField::WIND);
+        field->vector = glm::vec3(j["acceleration"][0], j["acceleration"][1], j["acceleration"][2]);
+    } else if (type == "drag") {
+        field = std::make_shared<ForceField>(ForceField::DRAG);
+        field->strength = j["coefficient"];
+        if (j.find("velocity") != j.end()) {
+            field->vector = glm::vec3(j["velocity"][0], j["velocity"][1], j["velocity"][2]);
+        }
+    } else {
+        std::cerr << "Unknown force field type: " << type << std::endl;
+        return nullptr;
+    }
+
+    // check for optional parameters
+    if (j.find("position") != j.end()) {
+        field->position = glm::vec3(j["position"][0], j["position"][1], j["position"][2]);
+    }
+    if (j.find("strength") != j.end()) {
+        field->strength = j["strength"];
+    }
+    if (j.find("radius") != j.end()) {
+        field->radius = j["radius"];
+    }
+    if (j.find("region") != j.end()) {
+        field->hasRegion = true;
+        field->regionMin = glm::vec3(j["region"]["min"][0], j["region"]["min"][1], j["region"]["min"][2]);
+        field->regionMax = glm::vec3(j["region"]["max"][0], j["region"]["max"][1], j["region"]["max"][2]);
+    }
+    if (j.find("enabled") != j.end()) {
+        field->enabled = j["enabled"];
+    }
+
+    return field;
+}
+
+std::shared_ptr<Emitter> parseEmitter(json j) {
+    glm::vec3 position = glm::vec3(j["position"][0], j["position"][1], j["position"][2]);
+    unsigned int seed = 0;
+    if (j.find("seed") != j.end()) {
+        seed = j["seed"];
+    }
+    std::shared_ptr<Emitter> emitter = std::make_shared<Emitter>(position, seed);
+
+    // check for optional parameters
+    if (j.find("direction") != j.end()) {
+        emitter->direction = glm::vec3(j["direction"][0], j["direction"][1], j["direction"][2]);
+    }
+    if (j.find("coneAngle") != j.end()) {
+        emitter->coneAngle = j["coneAngle"];
+    }
+    if (j.find("spawnRadius") != j.end()) {
+        emitter->spawnRadius = j["spawnRadius"];
+    }
+    if (j.find("speed") != j.end()) {
+        emitter->speed = j["speed"];
+    }
+    if (j.find("rate") != j.end()) {
+        emitter->rate = j["rate"];
+    }
+    if (j.find("radius") != j.end()) {
+        emitter->minRadius = j["radius"];
+        emitter->maxRadius = j["radius"];
+    }
+    if (j.find("minRadius") != j.end()) {
+        emitter->minRadius = j["minRadius"];
+    }
+    if (j.find("maxRadius") != j.end()) {
+        emitter->maxRadius = j["maxRadius"];
+    }
+    if (j.find("mass") != j.end()) {
+        emitter->mass = j["mass"];
+    }
+
+    return emitter;
+}
+
+std::shared_ptr<Sink> parseSink(json j) {
+    std::string type = j["type"];
+    glm::vec3 position = glm::vec3(j["position"][0], j["position"][1], j["position"][2]);
+    if (type == "box") {
+        return std::make_shared<Sink>(position, glm::vec3(j["size"][0], j["size"][1], j["size"][2]));
+    } else if (type == "sphere") {
+        return std::make_shared<Sink>(position, static_cast<float>(j["radius"]));
+    }
+    std::cerr << "Unknown sink type: " << type << std::endl;
+    return nullptr;
+}
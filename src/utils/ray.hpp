@@ -2,8 +2,15 @@
 
 #include <glm/glm.hpp>
 #include <memory>
+#include <limits>
 #include "../classes/particle.hpp"
 
+// result of a ray query: the first sphere along the ray (null if none) and the distance to it
+struct RayHit {
+    std::shared_ptr<Sphere> sphere;
+    float distance = std::numeric_limits<float>::max();
+};
+
 class Ray {
 public:
     glm::vec3 origin;
@@ -12,4 +19,5 @@ public:
     Ray(const glm::vec3& origin, const glm::vec3& direction);
 
     float intersect(const std::shared_ptr<Sphere>& sphere);
+    float intersect(const Sphere& sphere) const; // distance along the ray of the first intersection, max float if none
 };
\ No newline at end of file